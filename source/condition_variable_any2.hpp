@@ -150,31 +150,37 @@ class condition_variable_any2
     //***************************************** 
 
     // x.6.2.1 dealing with interrupts:
+    // - Token may be any stoppable_token (stop_token, never_stop_token, ...)
+    // - the token is borrowed, the stop callback is the token's callback_type
+    // - for unstoppable tokens these are the plain predicate waits
 
     // return:
     // - true if pred() yields true
     // - false otherwise (i.e. on interrupt)
-    template <class Lockable,class Predicate>
-      bool wait(Lockable& lock,
-                stop_token stoken,
-                Predicate pred);
+    template <class Lockable, class Token, class Predicate>
+      enable_if_t<stoppable_token<Token>, bool>
+      wait(Lockable& lock,
+           const Token& stoken,
+           Predicate pred);
 
     // return:
     // - true if pred() yields true
     // - false otherwise (i.e. on timeout or interrupt)
-    template <class Lockable, class Clock, class Duration, class Predicate>
-      bool wait_until(Lockable& lock,
-                      stop_token stoken,
-                      const chrono::time_point<Clock, Duration>& abs_time,
-                      Predicate pred);
+    template <class Lockable, class Token, class Clock, class Duration, class Predicate>
+      enable_if_t<stoppable_token<Token>, bool>
+      wait_until(Lockable& lock,
+                 const Token& stoken,
+                 const chrono::time_point<Clock, Duration>& abs_time,
+                 Predicate pred);
     // return:
     // - true if pred() yields true
     // - false otherwise (i.e. on timeout or interrupt)
-    template <class Lockable, class Rep, class Period, class Predicate>
-      bool wait_for(Lockable& lock,
-                    stop_token stoken,
-                    const chrono::duration<Rep, Period>& rel_time,
-                    Predicate pred);
+    template <class Lockable, class Token, class Rep, class Period, class Predicate>
+      enable_if_t<stoppable_token<Token>, bool>
+      wait_for(Lockable& lock,
+               const Token& stoken,
+               const chrono::duration<Rep, Period>& rel_time,
+               Predicate pred);
 
   //***************************************** 
   //* implementation:
@@ -213,28 +219,35 @@ class condition_variable_any2
 // return value:
 // - true if pred() yields true
 // - false otherwise (i.e. on interrupt)
-template <class Lockable, class Predicate>
-inline bool condition_variable_any2::wait(Lockable& lock,
-                                          stop_token stoken,
-                                          Predicate pred)
+template <class Lockable, class Token, class Predicate>
+inline enable_if_t<stoppable_token<Token>, bool>
+condition_variable_any2::wait(Lockable& lock,
+                              const Token& stoken,
+                              Predicate pred)
 {
-    if (stoken.stop_requested()) {
-      return pred();
+    if constexpr (unstoppable_token<Token>) {
+        wait(lock, std::move(pred));
+        return true;
     }
-    auto local_internals=internals;
-    stop_callback cb(stoken, [&local_internals] { local_internals->notify_all(); });
-    while (!pred()) {
-        std::unique_lock<std::mutex> first_internal_lock(local_internals->m);
+    else {
         if (stoken.stop_requested()) {
-            // pred() has already evaluated to 'false' since we last a acquired 'lock'
-            return false;
+            return pred();
         }
-        unlock_guard<Lockable> unlocker(lock);
-        std::unique_lock<std::mutex> second_internal_lock(std::move(first_internal_lock));
-        local_internals->cv.wait(second_internal_lock);
+        auto local_internals=internals;
+        auto notifier = [&local_internals] { local_internals->notify_all(); };
+        stop_callback_for_t<Token, decltype(notifier)> cb(stoken, notifier);
+        while (!pred()) {
+            std::unique_lock<std::mutex> first_internal_lock(local_internals->m);
+            if (stoken.stop_requested()) {
+                // pred() has already evaluated to 'false' since we last a acquired 'lock'
+                return false;
+            }
+            unlock_guard<Lockable> unlocker(lock);
+            std::unique_lock<std::mutex> second_internal_lock(std::move(first_internal_lock));
+            local_internals->cv.wait(second_internal_lock);
+        }
+        return true;
     }
-
-    return true;
 }
 
 // wait_until(): timed wait with interrupt handling 
@@ -242,37 +255,44 @@ inline bool condition_variable_any2::wait(Lockable& lock,
 // return:
 // - true if pred() yields true
 // - false otherwise (i.e. on timeout or interrupt)
-template <class Lockable, class Clock, class Duration, class Predicate>
-inline bool condition_variable_any2::wait_until(Lockable& lock,
-                                                stop_token stoken,
-                                                const chrono::time_point<Clock, Duration>& abs_time,
-                                                Predicate pred)
+template <class Lockable, class Token, class Clock, class Duration, class Predicate>
+inline enable_if_t<stoppable_token<Token>, bool>
+condition_variable_any2::wait_until(Lockable& lock,
+                                    const Token& stoken,
+                                    const chrono::time_point<Clock, Duration>& abs_time,
+                                    Predicate pred)
 {
-    if (stoken.stop_requested()) {
-      return pred();
+    if constexpr (unstoppable_token<Token>) {
+        return wait_until(lock, abs_time, std::move(pred));
     }
-    // have to manually implement the loop so that the user-provided lock is reacquired before calling pred().
-    // (otherwise the test_cvrace_pred test case fails)
-    auto local_internals=internals;
-    stop_callback cb(stoken, [&local_internals] { local_internals->notify_all(); });
-    while (!pred()) {
-        bool shouldStop;
-        {
-            std::unique_lock<std::mutex> first_internal_lock(local_internals->m);
-            if (stoken.stop_requested()) {
-                // pred() has already evaluated to 'false' since we last acquired 'lock'.
-                return false;
-            }
-            unlock_guard<Lockable> unlocker(lock);
-            std::unique_lock<std::mutex> second_internal_lock(std::move(first_internal_lock));
-            const auto status = local_internals->cv.wait_until(second_internal_lock, abs_time);
-            shouldStop = (status == std::cv_status::timeout) || stoken.stop_requested();
-        }
-        if (shouldStop) {
+    else {
+        if (stoken.stop_requested()) {
             return pred();
         }
+        // have to manually implement the loop so that the user-provided lock is reacquired before calling pred().
+        // (otherwise the test_cvrace_pred test case fails)
+        auto local_internals=internals;
+        auto notifier = [&local_internals] { local_internals->notify_all(); };
+        stop_callback_for_t<Token, decltype(notifier)> cb(stoken, notifier);
+        while (!pred()) {
+            bool shouldStop;
+            {
+                std::unique_lock<std::mutex> first_internal_lock(local_internals->m);
+                if (stoken.stop_requested()) {
+                    // pred() has already evaluated to 'false' since we last acquired 'lock'.
+                    return false;
+                }
+                unlock_guard<Lockable> unlocker(lock);
+                std::unique_lock<std::mutex> second_internal_lock(std::move(first_internal_lock));
+                const auto status = local_internals->cv.wait_until(second_internal_lock, abs_time);
+                shouldStop = (status == std::cv_status::timeout) || stoken.stop_requested();
+            }
+            if (shouldStop) {
+                return pred();
+            }
+        }
+        return true;
     }
-    return true;
 }
 
 // wait_for(): timed wait with interrupt handling 
@@ -280,15 +300,16 @@ inline bool condition_variable_any2::wait_until(Lockable& lock,
 // return:
 // - true if pred() yields true
 // - false otherwise (i.e. on timeout or interrupt)
-template <class Lockable,class Rep, class Period, class Predicate>
-inline bool condition_variable_any2::wait_for(Lockable& lock,
-                                              stop_token stoken,
-                                              const chrono::duration<Rep, Period>& rel_time,
-                                              Predicate pred)
+template <class Lockable, class Token, class Rep, class Period, class Predicate>
+inline enable_if_t<stoppable_token<Token>, bool>
+condition_variable_any2::wait_for(Lockable& lock,
+                                  const Token& stoken,
+                                  const chrono::duration<Rep, Period>& rel_time,
+                                  Predicate pred)
 {
   auto abs_time = std::chrono::steady_clock::now() + rel_time;
   return wait_until(lock,
-                    std::move(stoken),
+                    stoken,
                     abs_time,
                     std::move(pred));
 }
@@ -8,11 +8,1051 @@
 #include <thread>
 #include <future>
 #include <type_traits>
+#include <chrono>
 #include <functional>  // for invoke()
 #include <iostream>    // for debugging output
+#include <atomic>
+#include <condition_variable>
+#include <cerrno>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include <utility>
+#include <vector>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// fused thread start (see __jthread_start_block):
+// - needs std::thread to be a pthread and std::thread::id(pthread_t)
+// - define JTHREAD_NO_FUSED_START to start threads with std::thread
+#if defined(__GLIBCXX__) && defined(__linux__) && !defined(JTHREAD_NO_FUSED_START)
+#define JTHREAD_FUSED_START 1
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 namespace std {
 
+//***************************************** 
+//* class __lazy_stop_source
+//* - stop_source of a jthread with the stop state allocated on first use:
+//*   a callable not taking a stop_token can't observe it,
+//*   so fire-and-join threads don't need one
+//* - stop requested before first use is recorded without a state
+//***************************************** 
+class __lazy_stop_source
+{
+  public:
+    struct lazy_t { explicit lazy_t() = default; };
+
+    __lazy_stop_source(nostopstate_t) noexcept
+     : _state{nullptr} {
+    }
+    explicit __lazy_stop_source(stop_source&& src) noexcept
+     : _state{__stop_source_access::__release(src)} {
+    }
+    explicit __lazy_stop_source(lazy_t) noexcept
+     : _state{pending()} {
+    }
+    ~__lazy_stop_source() {
+      reset();
+    }
+
+    __lazy_stop_source(__lazy_stop_source&& t) noexcept
+     : _state{t._state.exchange(nullptr, ::std::memory_order_relaxed)} {
+    }
+    __lazy_stop_source& operator=(__lazy_stop_source&& t) noexcept {
+      reset();
+      _state.store(t._state.exchange(nullptr, ::std::memory_order_relaxed),
+                   ::std::memory_order_relaxed);
+      return *this;
+    }
+
+    // - creates the stop state on first use
+    //   (terminates if that fails, as the callers are noexcept)
+    stop_source get() const noexcept;
+    bool request_stop() noexcept;
+
+    void swap(__lazy_stop_source& t) noexcept {
+      auto* tmp = _state.load(::std::memory_order_relaxed);
+      _state.store(t._state.load(::std::memory_order_relaxed), ::std::memory_order_relaxed);
+      t._state.store(tmp, ::std::memory_order_relaxed);
+    }
+
+  private:
+    // _state: nullptr (no stop state), pending(), stopped() or an owned state
+    static __stop_state* pending() noexcept {
+      return reinterpret_cast<__stop_state*>(&_pendingTag);
+    }
+    static __stop_state* stopped() noexcept {
+      return reinterpret_cast<__stop_state*>(&_stoppedTag);
+    }
+    static bool isLazy(__stop_state* state) noexcept {
+      return state == pending() || state == stopped();
+    }
+
+    void reset() noexcept {
+      auto* state = _state.exchange(nullptr, ::std::memory_order_relaxed);
+      if (state != nullptr && !isLazy(state)) {
+        __stop_source_access::__adopt(state);  // releases the reference
+      }
+    }
+
+    static inline char _pendingTag{};
+    static inline char _stoppedTag{};
+    mutable ::std::atomic<__stop_state*> _state;
+};
+
+
+// called at join with the stack high-water mark of threads started with
+// jthread_attributes::measure_stack (see set_jthread_stack_report())
+using jthread_stack_report = void (*)(::std::thread::id id,
+                                      ::std::size_t used, ::std::size_t size);
+inline ::std::atomic<jthread_stack_report>& __jthread_stack_report_hook() noexcept {
+  static ::std::atomic<jthread_stack_report> hook{nullptr};
+  return hook;
+}
+
+#ifdef JTHREAD_FUSED_START
+inline void __futex_wait_private(::std::atomic<::std::uint32_t>& word,
+                                 ::std::uint32_t expected) noexcept {
+  ::syscall(SYS_futex, reinterpret_cast<::std::uint32_t*>(&word),
+            FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+}
+inline void __futex_wake_private(::std::atomic<::std::uint32_t>& word,
+                                 int count) noexcept {
+  ::syscall(SYS_futex, reinterpret_cast<::std::uint32_t*>(&word),
+            FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0);
+}
+// deadline: absolute CLOCK_MONOTONIC time (nullptr: none)
+// (false: timed out)
+inline bool __futex_wait_until_private(::std::atomic<::std::uint32_t>& word,
+                                       ::std::uint32_t expected,
+                                       const ::timespec* deadline) noexcept {
+  long r = ::syscall(SYS_futex, reinterpret_cast<::std::uint32_t*>(&word),
+                     FUTEX_WAIT_BITSET_PRIVATE, expected, deadline, nullptr,
+                     FUTEX_BITSET_MATCH_ANY);
+  return r == 0 || errno != ETIMEDOUT;
+}
+
+//***************************************** 
+//* class __jthread_exit_signal
+//* - incremented whenever a jthread finishes while a wait_any() waits,
+//*   so that it can sleep until one of its threads may have finished
+//* - without waiters, finishing threads only read the waiter count
+//***************************************** 
+class __jthread_exit_signal
+{
+  public:
+    static __jthread_exit_signal& instance() noexcept {
+      static __jthread_exit_signal signal;
+      return signal;
+    }
+
+    // called after the thread was marked as finished:
+    // - the fences pair with those in addWaiter(): a waiter either sees
+    //   the finished thread or is seen here (and gets woken)
+    void notify() noexcept {
+      ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+      if (_waiters.load(::std::memory_order_relaxed) != 0) {
+        _epoch.fetch_add(1);
+        __futex_wake_private(_epoch, INT_MAX);
+      }
+    }
+    // called before the epoch is read and the threads are checked:
+    void addWaiter() noexcept {
+      _waiters.fetch_add(1);
+      ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+    }
+    void removeWaiter() noexcept {
+      _waiters.fetch_sub(1);
+    }
+    ::std::uint32_t epoch() const noexcept {
+      return _epoch.load();
+    }
+    void wait(::std::uint32_t epoch) noexcept {
+      __futex_wait_private(_epoch, epoch);
+    }
+
+  private:
+    ::std::atomic<::std::uint32_t> _epoch{0};
+    ::std::atomic<::std::uint32_t> _waiters{0};
+};
+
+//***************************************** 
+//* struct __jthread_start_base / __jthread_start_block
+//* - the only allocation to start a jthread:
+//*   stop state, callable, and arguments
+//* - the stop state is a base: when its last reference goes away, its
+//*   release hook destroys and frees the whole block
+//*   (see __jthread_start_block::release())
+//* - the started thread invokes the callable in place, then destroys it
+//*   and the arguments and drops its token (which keeps the block alive)
+//***************************************** 
+struct __jthread_start_base : __stop_state
+{
+  stop_token token{};                          // reference of the started thread
+  // futex signaled by the started thread:
+  // - done: the callable has returned
+  // - released: the jthread was detached (a cached thread may be reused
+  //   once done, see __jthread_thread_cache)
+  // - waiting: someone sleeps on the futex (done has to wake it)
+  // - the bits above are incremented to interrupt waits (see waitFinished())
+  static constexpr ::std::uint32_t done = 1;
+  static constexpr ::std::uint32_t released = 2;
+  static constexpr ::std::uint32_t waiting = 4;
+  static constexpr ::std::uint32_t interrupt = 8;
+  ::std::atomic<::std::uint32_t> completion{0};
+  void (*execute)(__jthread_start_base*, const stop_token&) noexcept = nullptr;
+  // see jthread_attributes:
+  char name[16] = {};
+  void* userGuard = nullptr;                   // guard in caller-provided stack
+  ::std::size_t userGuardSize = 0;
+  bool measureStack = false;
+  ::std::size_t stackUsed = 0;                 // high-water mark (if measured)
+  ::std::size_t stackSize = 0;
+
+  // thread function of uncached threads
+  // (exceptions terminate as with std::thread):
+  static void* run(void* p) noexcept {
+    auto* block = static_cast<__jthread_start_base*>(p);
+    stop_token keepAlive = ::std::move(block->token);
+    if (block->name[0] != '\0') {
+      ::pthread_setname_np(::pthread_self(), block->name);
+    }
+    if (block->measureStack) {
+      block->paintStack();
+    }
+    block->execute(block, keepAlive);
+    if (block->measureStack) {
+      block->scanStack();
+    }
+    if (block->userGuard != nullptr) {
+      // the caller gets its memory back as it was
+      ::mprotect(block->userGuard, block->userGuardSize, PROT_READ | PROT_WRITE);
+    }
+    block->finish();
+    return nullptr;    // keepAlive goes away: may free the block
+  }
+
+  // the callable has returned: wake waiters (returns the previous state)
+  ::std::uint32_t finish() noexcept {
+    auto old = completion.fetch_or(done, ::std::memory_order_acq_rel);
+    if ((old & waiting) != 0) {
+      __futex_wake_private(completion, INT_MAX);
+    }
+    __jthread_exit_signal::instance().notify();
+    return old;
+  }
+
+  bool finished() const noexcept {
+    return (completion.load(::std::memory_order_acquire) & done) != 0;
+  }
+
+  // wait until finished (true), the deadline passed, or stop was
+  // requested on st (false)
+  bool waitFinished(const ::timespec* deadline, const stop_token& st) noexcept {
+    struct Interrupt {
+      __jthread_start_base* block;
+      void operator()() noexcept {
+        block->completion.fetch_add(interrupt, ::std::memory_order_release);
+        __futex_wake_private(block->completion, INT_MAX);
+      }
+    };
+    stop_callback<Interrupt> cb{st, Interrupt{this}};
+    ::std::uint32_t c = completion.load(::std::memory_order_acquire);
+    for (;;) {
+      if ((c & done) != 0) {
+        return true;
+      }
+      if (st.stop_requested()) {
+        return false;
+      }
+      if ((c & waiting) == 0 &&
+          !completion.compare_exchange_weak(c, c | waiting,
+                                            ::std::memory_order_acquire)) {
+        continue;
+      }
+      if (!__futex_wait_until_private(completion, c | waiting, deadline)) {
+        return finished();
+      }
+      c = completion.load(::std::memory_order_acquire);
+    }
+  }
+
+  // stack high-water mark: fill the unused stack with a pattern before
+  // the callable runs, find the lowest overwritten byte afterwards
+  static constexpr unsigned char stackPattern = 0xA5;
+
+  bool stackBounds(unsigned char*& low, unsigned char*& high) noexcept {
+    ::pthread_attr_t attr;
+    if (::pthread_getattr_np(::pthread_self(), &attr) != 0) {
+      return false;
+    }
+    void* addr;
+    ::std::size_t size;
+    ::pthread_attr_getstack(&attr, &addr, &size);
+    ::pthread_attr_destroy(&attr);
+    // (glibc excludes its own guard, not one we put in a caller's stack)
+    low = static_cast<unsigned char*>(addr) + userGuardSize;
+    high = static_cast<unsigned char*>(addr) + size;
+    stackSize = static_cast<::std::size_t>(high - low);
+    return true;
+  }
+
+  __attribute__((noinline, no_sanitize_address))
+  void paintStack() noexcept {
+    unsigned char* low;
+    unsigned char* high;
+    if (!stackBounds(low, high)) {
+      measureStack = false;
+      return;
+    }
+    // below our frame (keeping a margin for the red zone and signal frames):
+    volatile unsigned char* end =
+        static_cast<unsigned char*>(__builtin_frame_address(0)) - 1024;
+    for (volatile unsigned char* q = low; q < end; ++q) {
+      *q = stackPattern;
+    }
+  }
+
+  __attribute__((noinline, no_sanitize_address))
+  void scanStack() noexcept {
+    unsigned char* low;
+    unsigned char* high;
+    if (!stackBounds(low, high)) {
+      return;
+    }
+    const volatile unsigned char* q = low;
+    while (q < high && *q == stackPattern) {
+      ++q;
+    }
+    stackUsed = static_cast<::std::size_t>(high - q);
+  }
+};
+
+template <typename Callable, typename... Args>
+struct __jthread_start_block : __jthread_start_base
+{
+  using call_type = ::std::tuple<::std::decay_t<Callable>, ::std::decay_t<Args>...>;
+  // over-aligned callables/arguments are stored separately
+  // (::operator new() only guarantees the default alignment)
+  static constexpr bool indirect =
+      alignof(call_type) > __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+  using storage_type = ::std::conditional_t<indirect,
+                                            ::std::unique_ptr<call_type>,
+                                            call_type>;
+
+  template <typename... T>
+  explicit __jthread_start_block(T&&... t)
+   : call{makeStorage(::std::forward<T>(t)...)} {
+    execute = &executeCall;
+    __set_release(&release);
+  }
+
+  // call is destroyed by destroyCall() (once the callable has returned)
+  ~__jthread_start_block() {
+  }
+
+  // memory of the block (released with the last stop state reference):
+  static_assert(alignof(__jthread_start_base) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                "start block needs over-aligned allocation");
+  static void* allocate() {
+    return ::operator new(sizeof(__jthread_start_block));
+  }
+  static void deallocate(void* p) noexcept {
+    ::operator delete(p, sizeof(__jthread_start_block));
+  }
+  static void release(__stop_state* state) noexcept {
+    auto* block = static_cast<__jthread_start_block*>(state);
+    block->~__jthread_start_block();
+    deallocate(block);
+  }
+
+  template <typename... T>
+  static storage_type makeStorage(T&&... t) {
+    if constexpr (indirect) {
+      return ::std::make_unique<call_type>(::std::forward<T>(t)...);
+    }
+    else {
+      return call_type{::std::forward<T>(t)...};
+    }
+  }
+
+  call_type& getCall() noexcept {
+    if constexpr (indirect) {
+      return *call;
+    }
+    else {
+      return call;
+    }
+  }
+
+  template <::std::size_t... I>
+  void invoke(const stop_token& st, ::std::index_sequence<I...>) {
+    call_type& c = getCall();
+    if constexpr(std::is_invocable_v<Callable, stop_token, Args...>) {
+      // pass the stop_token as first argument to the started thread
+      // (a copy: the thread's own reference must outlive the callable)
+      ::std::invoke(::std::move(::std::get<0>(c)),
+                    stop_token{st},
+                    ::std::move(::std::get<I + 1>(c))...);
+    }
+    else {
+      ::std::invoke(::std::move(::std::get<0>(c)),
+                    ::std::move(::std::get<I + 1>(c))...);
+    }
+  }
+
+  void destroyCall() noexcept {
+    call.~storage_type();
+  }
+
+  static void executeCall(__jthread_start_base* base, const stop_token& st) noexcept {
+    auto* block = static_cast<__jthread_start_block*>(base);
+    block->invoke(st, ::std::index_sequence_for<Args...>{});
+    block->destroyCall();
+  }
+
+  union {
+    storage_type call;
+  };
+};
+
+//***************************************** 
+//* class __jthread_thread_cache
+//* - opt-in (see set_jthread_cache_limit()): finished threads park and
+//*   run the next jthread instead of exiting
+//*   (saves pthread_create() and the stack mmap()/munmap())
+//* - a thread is reused only after its jthread was joined or detached,
+//*   so ids stay unique among unjoined jthreads
+//* - NOTE: a reused thread is NOT a new thread:
+//*   - thread_local objects keep the values the previous callable left
+//*     and are destroyed only when the OS thread exits
+//*   - the same goes for per-thread OS state (signal mask, name,
+//*     priority/affinity, errno)
+//*   so only enable it for callables that don't rely on fresh threads
+//***************************************** 
+class __jthread_thread_cache
+{
+  public:
+    struct worker {
+      ::pthread_t handle{};
+      ::std::atomic<::std::uint32_t> wake{0};  // futex: incremented per hand-off
+      __jthread_start_base* block = nullptr;   // nullptr on wake: exit
+    };
+
+    static __jthread_thread_cache& instance() noexcept {
+      // never destroyed: parked threads may still use it at exit
+      static auto* cache = new __jthread_thread_cache;
+      return *cache;
+    }
+
+    ::std::size_t limit() const noexcept {
+      return _limit.load(::std::memory_order_relaxed);
+    }
+
+    void setLimit(::std::size_t limit) {
+      ::std::vector<worker*> excess;
+      {
+        ::std::lock_guard<::std::mutex> lg{_mutex};
+        _limit.store(limit, ::std::memory_order_relaxed);
+        while (_idle.size() > limit) {
+          excess.push_back(_idle.back());
+          _idle.pop_back();
+        }
+      }
+      for (auto* w : excess) {
+        handOff(w, nullptr);
+      }
+    }
+
+    // run block on a parked thread (or a new one)
+    worker* start(__jthread_start_base* block) {
+      worker* w = nullptr;
+      {
+        ::std::lock_guard<::std::mutex> lg{_mutex};
+        if (!_idle.empty()) {
+          w = _idle.back();
+          _idle.pop_back();
+        }
+      }
+      if (w != nullptr) {
+        handOff(w, block);
+        return w;
+      }
+      w = new worker;
+      w->block = block;
+      w->wake.store(1, ::std::memory_order_relaxed);
+      ::pthread_attr_t attr;
+      ::pthread_attr_init(&attr);
+      ::pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+      int err = ::pthread_create(&w->handle, &attr, &loop, w);
+      ::pthread_attr_destroy(&attr);
+      if (err != 0) {
+        delete w;
+        throw ::std::system_error{err, ::std::generic_category(), "pthread_create"};
+      }
+      return w;
+    }
+
+    // the jthread of w's block was joined or detached and the block is done
+    void release(worker* w) noexcept {
+      {
+        ::std::lock_guard<::std::mutex> lg{_mutex};
+        if (_idle.size() < limit()) {
+          try {
+            _idle.push_back(w);
+            return;
+          }
+          catch (...) {
+            // can't park: let it exit
+          }
+        }
+      }
+      handOff(w, nullptr);
+    }
+
+  private:
+    __jthread_thread_cache() noexcept {
+      // parked threads don't exist in a forked child:
+      ::pthread_atfork([] { instance()._mutex.lock(); },
+                       [] { instance()._mutex.unlock(); },
+                       [] { instance()._idle.clear();   // (leaks the workers)
+                            instance()._mutex.unlock(); });
+    }
+
+    static void handOff(worker* w, __jthread_start_base* block) noexcept {
+      w->block = block;
+      w->wake.fetch_add(1, ::std::memory_order_release);
+      __futex_wake_private(w->wake, 1);
+    }
+
+    static void* loop(void* p) noexcept {
+      auto* w = static_cast<worker*>(p);
+      ::std::uint32_t seen = 0;
+      for (;;) {
+        ::std::uint32_t wake;
+        while ((wake = w->wake.load(::std::memory_order_acquire)) == seen) {
+          __futex_wait_private(w->wake, seen);
+        }
+        seen = wake;
+        auto* block = w->block;
+        if (block == nullptr) {
+          delete w;
+          return nullptr;
+        }
+        stop_token keepAlive = ::std::move(block->token);
+        block->execute(block, keepAlive);
+        auto old = block->finish();
+        keepAlive = stop_token{};              // may free the block
+        if ((old & __jthread_start_base::released) != 0) {
+          instance().release(w);               // detached: reuse now
+        }
+      }
+    }
+
+    ::std::mutex _mutex;
+    ::std::vector<worker*> _idle;
+    ::std::atomic<::std::size_t> _limit{0};
+};
+
+//***************************************** 
+//* class __pthread_handle
+//* - started thread with the API of std::thread (joinable(), join(), ...)
+//* - for cached threads, join() waits for the callable to return and
+//*   detach() lets the thread be reused once it does
+//***************************************** 
+class __pthread_handle
+{
+  public:
+    __pthread_handle() noexcept = default;
+    __pthread_handle(::pthread_t handle, __jthread_start_base* block) noexcept
+     : _handle{handle}, _id{handle}, _block{block} {
+    }
+    __pthread_handle(__jthread_thread_cache::worker* worker,
+                     __jthread_start_base* block) noexcept
+     : _handle{worker->handle}, _id{worker->handle},
+       _worker{worker}, _block{block} {
+    }
+    __pthread_handle(__pthread_handle&& t) noexcept
+     : _handle{t._handle}, _id{::std::exchange(t._id, ::std::thread::id{})},
+       _worker{t._worker}, _block{t._block}, _stackUsed{t._stackUsed} {
+    }
+    __pthread_handle& operator=(__pthread_handle&& t) noexcept {
+      if (joinable()) {
+        ::std::terminate();
+      }
+      _handle = t._handle;
+      _id = ::std::exchange(t._id, ::std::thread::id{});
+      _worker = t._worker;
+      _block = t._block;
+      _stackUsed = t._stackUsed;
+      return *this;
+    }
+    ~__pthread_handle() {
+      if (joinable()) {
+        ::std::terminate();
+      }
+    }
+
+    bool joinable() const noexcept {
+      return _id != ::std::thread::id{};
+    }
+    void join() {
+      int err = EINVAL;
+      if (_id == ::std::this_thread::get_id()) {
+        err = EDEADLK;
+      }
+      else if (joinable() && _worker != nullptr) {
+        _block->waitFinished(nullptr, stop_token{});
+        __jthread_thread_cache::instance().release(_worker);
+        err = 0;
+      }
+      else if (joinable()) {
+        err = ::pthread_join(_handle, nullptr);
+      }
+      if (err != 0) {
+        throw ::std::system_error{err, ::std::generic_category(), "join"};
+      }
+      if (_block->measureStack) {
+        _stackUsed = _block->stackUsed;
+        if (auto report = __jthread_stack_report_hook().load()) {
+          report(_id, _block->stackUsed, _block->stackSize);
+        }
+      }
+      _id = ::std::thread::id{};
+    }
+    void detach() {
+      int err = EINVAL;
+      if (joinable() && _worker != nullptr) {
+        auto old = _block->completion.fetch_or(__jthread_start_base::released,
+                                               ::std::memory_order_acq_rel);
+        if ((old & __jthread_start_base::done) != 0) {
+          __jthread_thread_cache::instance().release(_worker);
+        }
+        err = 0;
+      }
+      else if (joinable()) {
+        err = ::pthread_detach(_handle);
+      }
+      if (err != 0) {
+        throw ::std::system_error{err, ::std::generic_category(), "detach"};
+      }
+      _id = ::std::thread::id{};
+    }
+    ::std::thread::id get_id() const noexcept {
+      return _id;
+    }
+    ::pthread_t native_handle() noexcept {
+      return _handle;
+    }
+    ::std::size_t stackHighWaterMark() const noexcept {
+      return _stackUsed;
+    }
+
+    // for joinable threads: the callable has returned
+    bool finished() const noexcept {
+      return _block->finished();
+    }
+    // for joinable threads: wait until finished (true), the deadline
+    // (nullptr: none) passed, or stop was requested on st (false)
+    bool waitUntil(const ::std::chrono::steady_clock::time_point* deadline,
+                   const stop_token& st) noexcept {
+      if (deadline == nullptr) {
+        return _block->waitFinished(nullptr, st);
+      }
+      // (steady_clock is CLOCK_MONOTONIC)
+      auto since = ::std::max(deadline->time_since_epoch(),
+                              ::std::chrono::steady_clock::duration::zero());
+      auto sec = ::std::chrono::duration_cast<::std::chrono::seconds>(since);
+      ::timespec ts;
+      ts.tv_sec = static_cast<::std::time_t>(sec.count());
+      ts.tv_nsec = static_cast<long>(
+          ::std::chrono::duration_cast<::std::chrono::nanoseconds>(since - sec).count());
+      return _block->waitFinished(&ts, st);
+    }
+
+  private:
+    ::pthread_t _handle{};
+    ::std::thread::id _id{};                   // no thread::id: not joinable
+    __jthread_thread_cache::worker* _worker = nullptr;  // cached thread
+    __jthread_start_base* _block = nullptr;    // (kept alive by the jthread)
+    ::std::size_t _stackUsed = 0;              // measured, after join()
+};
+
+using __jthread_native_thread = __pthread_handle;
+#else
+//***************************************** 
+//* class __jthread_exit_signal
+//* - incremented whenever a jthread finishes while a wait_any() waits,
+//*   so that it can sleep until one of its threads may have finished
+//* - without waiters, finishing threads only read the waiter count
+//*   (no lock, no notify)
+//***************************************** 
+class __jthread_exit_signal
+{
+  public:
+    static __jthread_exit_signal& instance() noexcept {
+      // never destroyed: detached threads may still finish at exit
+      static auto* signal = new __jthread_exit_signal;
+      return *signal;
+    }
+
+    // (fences: see the futex-based version above)
+    void notify() noexcept {
+      ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+      if (_waiters.load(::std::memory_order_relaxed) == 0) {
+        return;
+      }
+      {
+        ::std::lock_guard<::std::mutex> lg{_mutex};
+        ++_epoch;
+      }
+      _cv.notify_all();
+    }
+    void addWaiter() noexcept {
+      _waiters.fetch_add(1);
+      ::std::atomic_thread_fence(::std::memory_order_seq_cst);
+    }
+    void removeWaiter() noexcept {
+      _waiters.fetch_sub(1);
+    }
+    ::std::uint32_t epoch() noexcept {
+      ::std::lock_guard<::std::mutex> lg{_mutex};
+      return _epoch;
+    }
+    void wait(::std::uint32_t epoch) noexcept {
+      ::std::unique_lock<::std::mutex> lock{_mutex};
+      _cv.wait(lock, [&] { return _epoch != epoch; });
+    }
+
+  private:
+    ::std::mutex _mutex;
+    ::std::condition_variable _cv;
+    ::std::uint32_t _epoch = 0;
+    ::std::atomic<::std::uint32_t> _waiters{0};
+};
+
+//***************************************** 
+//* struct __jthread_completion
+//* - signaled by a thread started with std::thread when it finishes
+//***************************************** 
+struct __jthread_completion
+{
+  ::std::mutex m;
+  ::std::condition_variable cv;
+  bool done = false;
+
+  // signals at the end of the thread function:
+  struct Guard {
+    __jthread_completion& completion;
+    ~Guard() {
+      completion.finish();
+    }
+  };
+
+  void finish() noexcept {
+    {
+      ::std::lock_guard<::std::mutex> lg{m};
+      done = true;
+    }
+    cv.notify_all();
+    __jthread_exit_signal::instance().notify();
+  }
+  bool finished() noexcept {
+    ::std::lock_guard<::std::mutex> lg{m};
+    return done;
+  }
+  bool waitUntil(const ::std::chrono::steady_clock::time_point* deadline,
+                 const stop_token& st) noexcept {
+    auto interrupt = [this] {
+      { ::std::lock_guard<::std::mutex> lg{m}; }
+      cv.notify_all();
+    };
+    stop_callback<decltype(interrupt)> cb{st, interrupt};
+    ::std::unique_lock<::std::mutex> lock{m};
+    auto pred = [&] { return done || st.stop_requested(); };
+    if (deadline == nullptr) {
+      cv.wait(lock, pred);
+    }
+    else {
+      cv.wait_until(lock, *deadline, pred);
+    }
+    return done;
+  }
+};
+
+//***************************************** 
+//* class __std_thread_handle
+//* - std::thread with a __jthread_completion (see jthread::join_for())
+//***************************************** 
+class __std_thread_handle
+{
+  public:
+    __std_thread_handle() noexcept = default;
+    __std_thread_handle(::std::thread&& t,
+                        ::std::shared_ptr<__jthread_completion> completion) noexcept
+     : _thread{::std::move(t)}, _completion{::std::move(completion)} {
+    }
+
+    bool joinable() const noexcept {
+      return _thread.joinable();
+    }
+    void join() {
+      _thread.join();
+    }
+    void detach() {
+      _thread.detach();
+    }
+    ::std::thread::id get_id() const noexcept {
+      return _thread.get_id();
+    }
+    ::std::thread::native_handle_type native_handle() {
+      return _thread.native_handle();
+    }
+
+    bool finished() const noexcept {
+      return _completion->finished();
+    }
+    bool waitUntil(const ::std::chrono::steady_clock::time_point* deadline,
+                   const stop_token& st) noexcept {
+      return _completion->waitUntil(deadline, st);
+    }
+
+  private:
+    ::std::thread _thread;
+    ::std::shared_ptr<__jthread_completion> _completion;
+};
+
+using __jthread_native_thread = __std_thread_handle;
+#endif
+
+//***************************************** 
+//* set_jthread_cache_limit(), jthread_cache_limit():
+//* - keep up to limit finished OS threads parked for later jthreads
+//*   (default 0: every jthread gets a new OS thread)
+//* - a parked thread keeps its thread_local objects and per-thread OS
+//*   state when it runs the next callable (see __jthread_thread_cache)
+//* - lowering the limit lets excess parked threads exit
+//* - has no effect without JTHREAD_FUSED_START
+//***************************************** 
+inline void set_jthread_cache_limit([[maybe_unused]] ::std::size_t limit) {
+#ifdef JTHREAD_FUSED_START
+  __jthread_thread_cache::instance().setLimit(limit);
+#endif
+}
+inline ::std::size_t jthread_cache_limit() noexcept {
+#ifdef JTHREAD_FUSED_START
+  return __jthread_thread_cache::instance().limit();
+#else
+  return 0;
+#endif
+}
+
+
+//***************************************** 
+//* struct jthread_attributes
+//* - passed to the jthread constructor; applied before the callable runs:
+//*   - cpus: CPU affinity (empty: inherited)
+//*   - sched_policy/sched_priority: scheduling (SCHED_FIFO etc. usually
+//*     need privileges; -1: inherited)
+//*   - name: thread name for ps/perf/gdb (at most 15 characters)
+//*   - stack_size: stack reservation (0: default, usually 8 MiB)
+//*   - stack: caller-provided stack memory of stack_size bytes
+//*     (must outlive the thread)
+//*   - guard_size: guard below the stack (0: default, one page; with a
+//*     caller-provided stack, the lowest guard_size bytes of it are
+//*     protected while the thread runs, so it must be page-aligned)
+//*   - measure_stack: debug: record the stack high-water mark, see
+//*     jthread::stack_high_water_mark() and set_jthread_stack_report()
+//* - with the fused start, affinity and scheduling are pthread attributes
+//*   (the thread is pinned from its first instruction), otherwise the
+//*   new thread waits until they are set
+//* - stack attributes need the fused start
+//* - failures throw std::system_error from the constructor
+//*   (ENOTSUP where they can't be applied)
+//***************************************** 
+struct jthread_attributes
+{
+  ::std::vector<unsigned> cpus{};
+  int sched_policy = -1;
+  int sched_priority = 0;
+  ::std::string name{};
+  ::std::size_t stack_size = 0;
+  void* stack = nullptr;
+  ::std::size_t guard_size = 0;
+  bool measure_stack = false;
+};
+
+// report the stack high-water mark of threads started with measure_stack
+// at their join (nullptr: don't report)
+inline void set_jthread_stack_report(jthread_stack_report report) noexcept {
+  __jthread_stack_report_hook().store(report);
+}
+
+// (0 or errno)
+inline int __check_jthread_attributes(const jthread_attributes& attrs) noexcept {
+  if (attrs.name.size() > 15) {
+    return ERANGE;
+  }
+  if (attrs.stack != nullptr && attrs.stack_size == 0) {
+    return EINVAL;
+  }
+#ifndef JTHREAD_FUSED_START
+  if (attrs.stack_size != 0 || attrs.guard_size != 0 || attrs.measure_stack) {
+    return ENOTSUP;
+  }
+#endif
+#ifdef __linux__
+  for (unsigned cpu : attrs.cpus) {
+    if (cpu >= CPU_SETSIZE) {
+      return EINVAL;
+    }
+  }
+  return 0;
+#else
+  return attrs.cpus.empty() && attrs.sched_policy == -1 && attrs.name.empty()
+         ? 0 : ENOTSUP;
+#endif
+}
+
+#ifdef __linux__
+inline ::cpu_set_t __jthread_cpu_set(const jthread_attributes& attrs) noexcept {
+  ::cpu_set_t set;
+  CPU_ZERO(&set);
+  for (unsigned cpu : attrs.cpus) {
+    CPU_SET(cpu, &set);
+  }
+  return set;
+}
+#endif
+
+#ifdef JTHREAD_FUSED_START
+// pthread_attr_t for the affinity and scheduling of jthread_attributes
+class __jthread_pthread_attr
+{
+  public:
+    explicit __jthread_pthread_attr(const jthread_attributes& attrs) {
+      ::pthread_attr_init(&_attr);
+      int err = __check_jthread_attributes(attrs);
+      if (err == 0 && !attrs.cpus.empty()) {
+        ::cpu_set_t set = __jthread_cpu_set(attrs);
+        err = ::pthread_attr_setaffinity_np(&_attr, sizeof(set), &set);
+      }
+      if (err == 0 && attrs.stack != nullptr) {
+        err = ::pthread_attr_setstack(&_attr, attrs.stack, attrs.stack_size);
+      }
+      else if (err == 0 && attrs.stack_size != 0) {
+        err = ::pthread_attr_setstacksize(&_attr, attrs.stack_size);
+      }
+      if (err == 0 && attrs.stack == nullptr && attrs.guard_size != 0) {
+        err = ::pthread_attr_setguardsize(&_attr, attrs.guard_size);
+      }
+      if (err == 0 && attrs.sched_policy != -1) {
+        ::sched_param param{};
+        param.sched_priority = attrs.sched_priority;
+        err = ::pthread_attr_setinheritsched(&_attr, PTHREAD_EXPLICIT_SCHED);
+        if (err == 0) {
+          err = ::pthread_attr_setschedpolicy(&_attr, attrs.sched_policy);
+        }
+        if (err == 0) {
+          err = ::pthread_attr_setschedparam(&_attr, &param);
+        }
+      }
+      if (err != 0) {
+        ::pthread_attr_destroy(&_attr);
+        throw ::std::system_error{err, ::std::generic_category(), "jthread_attributes"};
+      }
+    }
+    ~__jthread_pthread_attr() {
+      ::pthread_attr_destroy(&_attr);
+    }
+
+    // protect the guard of a caller-provided stack (0 or errno)
+    static int protectGuard(const jthread_attributes& attrs,
+                            __jthread_start_base& block) noexcept {
+      if (attrs.stack == nullptr || attrs.guard_size == 0) {
+        return 0;
+      }
+      const auto page = static_cast<::std::size_t>(::sysconf(_SC_PAGESIZE));
+      const ::std::size_t size = (attrs.guard_size + page - 1) / page * page;
+      if (reinterpret_cast<::std::uintptr_t>(attrs.stack) % page != 0 ||
+          size >= attrs.stack_size) {
+        return EINVAL;
+      }
+      if (::mprotect(attrs.stack, size, PROT_NONE) != 0) {
+        return errno;
+      }
+      block.userGuard = attrs.stack;
+      block.userGuardSize = size;
+      return 0;
+    }
+    __jthread_pthread_attr(const __jthread_pthread_attr&) = delete;
+    __jthread_pthread_attr& operator=(const __jthread_pthread_attr&) = delete;
+
+    const ::pthread_attr_t* get() const noexcept {
+      return &_attr;
+    }
+
+  private:
+    ::pthread_attr_t _attr;
+};
+#else
+// apply jthread_attributes to a started thread (0 or errno)
+inline int __apply_jthread_attributes([[maybe_unused]] ::std::thread& t,
+                                      const jthread_attributes& attrs) noexcept {
+  int err = __check_jthread_attributes(attrs);
+#ifdef __linux__
+  if (err == 0 && !attrs.cpus.empty()) {
+    ::cpu_set_t set = __jthread_cpu_set(attrs);
+    err = ::pthread_setaffinity_np(t.native_handle(), sizeof(set), &set);
+  }
+  if (err == 0 && attrs.sched_policy != -1) {
+    ::sched_param param{};
+    param.sched_priority = attrs.sched_priority;
+    err = ::pthread_setschedparam(t.native_handle(), attrs.sched_policy, &param);
+  }
+  if (err == 0 && !attrs.name.empty()) {
+    err = ::pthread_setname_np(t.native_handle(), attrs.name.c_str());
+  }
+#endif
+  return err;
+}
+
+// lets a started thread wait until its attributes are applied
+struct __jthread_start_gate
+{
+  ::std::mutex m;
+  ::std::condition_variable cv;
+  int state = 0;   // 1: run, 2: don't run the callable
+
+  bool wait() {
+    ::std::unique_lock<::std::mutex> lock{m};
+    cv.wait(lock, [this] { return state != 0; });
+    return state == 1;
+  }
+  void open(bool run) {
+    {
+      ::std::lock_guard<::std::mutex> lock{m};
+      state = run ? 1 : 2;
+    }
+    cv.notify_one();
+  }
+};
+#endif
+
+
 //***************************************** 
 //* class jthread
 //* - joining std::thread with signaling stop/end support 
@@ -36,8 +1076,12 @@ class jthread
     // THE constructor that starts the thread:
     // - NOTE: does SFINAE out copy constructor semantics
     template <typename Callable, typename... Args,
-              typename = ::std::enable_if_t<!::std::is_same_v<::std::decay_t<Callable>, jthread>>>
+              typename = ::std::enable_if_t<!::std::is_same_v<::std::decay_t<Callable>, jthread> &&
+                                            !::std::is_same_v<::std::decay_t<Callable>, jthread_attributes>>>
     explicit jthread(Callable&& cb, Args&&... args);
+    // - supplementary: start with thread attributes
+    template <typename Callable, typename... Args>
+    explicit jthread(const jthread_attributes& attrs, Callable&& cb, Args&&... args);
     ~jthread();
 
     jthread(const jthread&) = delete;
@@ -65,8 +1109,25 @@ class jthread
     [[nodiscard]] stop_source get_stop_source() noexcept;
     [[nodiscard]] stop_token get_stop_token() const noexcept;
     bool request_stop() noexcept {
-      return get_stop_source().request_stop();
+      // (doesn't create a stop state nobody can observe yet)
+      return _stopSource.request_stop();
     }
+    //   - after join() of a thread started with measure_stack
+    //     (0 otherwise): bytes of stack used at most
+    [[nodiscard]] ::std::size_t stack_high_water_mark() const noexcept;
+    //   - join unless the thread is still running after a timeout or
+    //     when stop is requested on st (true: joined)
+    template <typename Rep, typename Period>
+    bool join_for(const ::std::chrono::duration<Rep, Period>& rel);
+    template <typename Clock, typename Duration>
+    bool join_until(const ::std::chrono::time_point<Clock, Duration>& abs);
+    bool join(const stop_token& st);
+    //   - wait until one of several threads has finished
+    template <typename ForwardIt>
+    friend ForwardIt wait_any(ForwardIt first, ForwardIt last);
+    //   - request stop and let a background thread join (instead of
+    //     blocking like the destructor); not joinable afterwards
+    void release_to_reaper();
 
 
   //***************************************** 
@@ -74,9 +1135,18 @@ class jthread
   //***************************************** 
 
   private:
+    template <typename Callable, typename... Args>
+    __jthread_native_thread start(const jthread_attributes* attrs,
+                                  Callable&& cb, Args&&... args);
+    bool joinUntil(const ::std::chrono::steady_clock::time_point* deadline,
+                   const stop_token& st);
+    bool finished() const noexcept {
+      return _thread.finished();
+    }
+
     //*** API for the starting thread:
-    stop_source _stopSource;                   // stop_source for started thread
-    ::std::thread _thread{};                   // started thread (if any)
+    __lazy_stop_source _stopSource;            // stop_source for started thread
+    __jthread_native_thread _thread{};         // started thread (if any)
 };
 
 
@@ -93,31 +1163,134 @@ inline jthread::jthread() noexcept
 
 // THE constructor that starts the thread:
 // - NOTE: declaration does SFINAE out copy constructor semantics
+// - without the fused start, the stop state is only created here
+//   if the callable takes a stop_token
 template <typename Callable, typename... Args,
           typename >
 inline jthread::jthread(Callable&& cb, Args&&... args)
- : _stopSource{},                             // initialize stop_source
-   _thread{[] (stop_token st, auto&& cb, auto&&... args) {   // called lambda in the thread
-                 // perform tasks of the thread:
-                 if constexpr(std::is_invocable_v<Callable, stop_token, Args...>) {
-                   // pass the stop_token as first argument to the started thread:
-                   ::std::invoke(::std::forward<decltype(cb)>(cb),
-                                 std::move(st),
-                                 ::std::forward<decltype(args)>(args)...);
-                 }
-                 else {
-                   // started thread does not expect a stop token:
-                   ::std::invoke(::std::forward<decltype(cb)>(cb),
-                                 ::std::forward<decltype(args)>(args)...);
-                 }
-               },
-               _stopSource.get_token(),   // not captured due to possible races if immediately set
-               ::std::forward<Callable>(cb),  // pass callable
-               ::std::forward<Args>(args)...  // pass arguments for callable
-           }
+ : _stopSource{__lazy_stop_source::lazy_t{}},   // initialize stop_source
+   _thread{start(nullptr, ::std::forward<Callable>(cb), ::std::forward<Args>(args)...)}
 {
 }
 
+template <typename Callable, typename... Args>
+inline jthread::jthread(const jthread_attributes& attrs, Callable&& cb, Args&&... args)
+ : _stopSource{__lazy_stop_source::lazy_t{}},
+   _thread{start(&attrs, ::std::forward<Callable>(cb), ::std::forward<Args>(args)...)}
+{
+}
+
+#ifdef JTHREAD_FUSED_START
+template <typename Callable, typename... Args>
+inline __jthread_native_thread jthread::start(const jthread_attributes* attrs,
+                                              Callable&& cb, Args&&... args)
+{
+  ::std::unique_ptr<__jthread_pthread_attr> pattr;
+  if (attrs != nullptr) {
+    pattr = ::std::make_unique<__jthread_pthread_attr>(*attrs);   // may throw
+  }
+  using block_t = __jthread_start_block<Callable, Args...>;
+  void* mem = block_t::allocate();
+  block_t* block;
+  try {
+    block = ::new (mem) block_t{::std::forward<Callable>(cb), ::std::forward<Args>(args)...};
+  }
+  catch (...) {
+    block_t::deallocate(mem);
+    throw;
+  }
+  // we own the source reference, the started thread a token reference:
+  stop_source src = __stop_source_access::__adopt(static_cast<__stop_state*>(block));
+  block->token = src.get_token();
+  _stopSource = __lazy_stop_source{::std::move(src)};
+
+  try {
+    auto& cache = __jthread_thread_cache::instance();
+    if (attrs == nullptr && cache.limit() > 0) {
+      return __pthread_handle{cache.start(block), block};
+    }
+    if (attrs != nullptr) {
+      // (length checked by __jthread_pthread_attr)
+      attrs->name.copy(block->name, sizeof(block->name) - 1);
+      block->measureStack = attrs->measure_stack;
+      int err = __jthread_pthread_attr::protectGuard(*attrs, *block);
+      if (err != 0) {
+        throw ::std::system_error{err, ::std::generic_category(), "jthread_attributes"};
+      }
+    }
+    ::pthread_t handle;
+    int err = ::pthread_create(&handle, pattr ? pattr->get() : nullptr,
+                               &__jthread_start_base::run, block);
+    if (err != 0) {
+      if (block->userGuard != nullptr) {
+        ::mprotect(block->userGuard, block->userGuardSize, PROT_READ | PROT_WRITE);
+      }
+      throw ::std::system_error{err, ::std::generic_category(), "pthread_create"};
+    }
+    return __pthread_handle{handle, block};
+  }
+  catch (...) {
+    block->destroyCall();
+    block->token = stop_token{};
+    throw;
+  }
+}
+#else
+template <typename Callable, typename... Args>
+inline __jthread_native_thread jthread::start(const jthread_attributes* attrs,
+                                              Callable&& cb, Args&&... args)
+{
+  ::std::shared_ptr<__jthread_start_gate> gate;
+  if (attrs != nullptr) {
+    gate = ::std::make_shared<__jthread_start_gate>();
+  }
+  auto completion = ::std::make_shared<__jthread_completion>();
+  ::std::thread t;
+  if constexpr(std::is_invocable_v<Callable, stop_token, Args...>) {
+    t = ::std::thread{[] (auto gate, auto completion, stop_token st, auto&& cb, auto&&... args) {   // called lambda in the thread
+                        __jthread_completion::Guard guard{*completion};
+                        if (gate != nullptr && !gate->wait()) {
+                          return;
+                        }
+                        // pass the stop_token as first argument to the started thread:
+                        ::std::invoke(::std::forward<decltype(cb)>(cb),
+                                      std::move(st),
+                                      ::std::forward<decltype(args)>(args)...);
+                      },
+                      gate,
+                      completion,
+                      _stopSource.get().get_token(),   // not captured due to possible races if immediately set
+                      ::std::forward<Callable>(cb),  // pass callable
+                      ::std::forward<Args>(args)...  // pass arguments for callable
+                     };
+  }
+  else {
+    // started thread does not expect a stop token:
+    t = ::std::thread{[] (auto gate, auto completion, auto&& cb, auto&&... args) {
+                        __jthread_completion::Guard guard{*completion};
+                        if (gate == nullptr || gate->wait()) {
+                          ::std::invoke(::std::forward<decltype(cb)>(cb),
+                                        ::std::forward<decltype(args)>(args)...);
+                        }
+                      },
+                      gate,
+                      completion,
+                      ::std::forward<Callable>(cb),
+                      ::std::forward<Args>(args)...
+                     };
+  }
+  if (gate != nullptr) {
+    int err = __apply_jthread_attributes(t, *attrs);
+    gate->open(err == 0);
+    if (err != 0) {
+      t.join();
+      throw ::std::system_error{err, ::std::generic_category(), "jthread_attributes"};
+    }
+  }
+  return __std_thread_handle{::std::move(t), ::std::move(completion)};
+}
+#endif
+
 // move assignment operator:
 inline jthread& jthread::operator=(jthread&& t) noexcept {
   if (joinable()) {   // if not joined/detached, signal stop and wait for end:
@@ -139,6 +1312,48 @@ inline jthread::~jthread() {
 }
 
 
+// lazy stop_source:
+inline stop_source __lazy_stop_source::get() const noexcept {
+  auto* state = _state.load(::std::memory_order_acquire);
+  while (isLazy(state)) {
+    // first use: create the stop state
+    stop_source src;
+    if (state == stopped()) {
+      src.request_stop();
+    }
+    auto* created = __stop_source_access::__state(src);
+    if (_state.compare_exchange_strong(state, created,
+                                       ::std::memory_order_acq_rel,
+                                       ::std::memory_order_acquire)) {
+      __stop_source_access::__release(src);    // now owned by _state
+      return __stop_source_access::__share(created);
+    }
+    // created by another thread or stop requested meanwhile: retry
+  }
+  if (state == nullptr) {
+    return stop_source{nostopstate};
+  }
+  return __stop_source_access::__share(state);
+}
+
+inline bool __lazy_stop_source::request_stop() noexcept {
+  auto* state = _state.load(::std::memory_order_acquire);
+  for (;;) {
+    if (state == nullptr || state == stopped()) {
+      return false;
+    }
+    if (state != pending()) {
+      return state->__request_stop();
+    }
+    if (_state.compare_exchange_weak(state, stopped(),
+                                     ::std::memory_order_acq_rel,
+                                     ::std::memory_order_acquire)) {
+      return true;
+    }
+  }
+}
+
+
 // others:
 inline bool jthread::joinable() const noexcept {
   return _thread.joinable();
@@ -149,6 +1364,55 @@ inline void jthread::join() {
 inline void jthread::detach() {
   _thread.detach();
 }
+
+// timed/cancellable join:
+template <typename Rep, typename Period>
+inline bool jthread::join_for(const ::std::chrono::duration<Rep, Period>& rel) {
+  auto deadline = ::std::chrono::steady_clock::now()
+                  + ::std::chrono::ceil<::std::chrono::steady_clock::duration>(rel);
+  return joinUntil(&deadline, stop_token{});
+}
+
+template <typename Clock, typename Duration>
+inline bool jthread::join_until(const ::std::chrono::time_point<Clock, Duration>& abs) {
+  using steady = ::std::chrono::steady_clock;
+  if constexpr(::std::is_same_v<Clock, steady>) {
+    auto deadline = ::std::chrono::ceil<steady::duration>(abs);
+    return joinUntil(&deadline, stop_token{});
+  }
+  else {
+    // wait on the steady clock, then check again (Clock may jump)
+    for (;;) {
+      auto deadline = steady::now()
+                      + ::std::chrono::ceil<steady::duration>(abs - Clock::now());
+      if (joinUntil(&deadline, stop_token{})) {
+        return true;
+      }
+      if (Clock::now() >= abs) {
+        return false;
+      }
+    }
+  }
+}
+
+inline bool jthread::join(const stop_token& st) {
+  return joinUntil(nullptr, st);
+}
+
+inline bool jthread::joinUntil(const ::std::chrono::steady_clock::time_point* deadline,
+                               const stop_token& st) {
+  if (!joinable()) {
+    throw ::std::system_error{EINVAL, ::std::generic_category(), "join"};
+  }
+  if (get_id() == ::std::this_thread::get_id()) {
+    throw ::std::system_error{EDEADLK, ::std::generic_category(), "join"};
+  }
+  if (!_thread.waitUntil(deadline, st)) {
+    return false;
+  }
+  join();
+  return true;
+}
 inline typename jthread::id jthread::get_id() const noexcept {
   return _thread.get_id();
 }
@@ -157,18 +1421,157 @@ inline typename jthread::native_handle_type jthread::native_handle() {
 }
 
 inline stop_source jthread::get_stop_source() noexcept {
-  return _stopSource;
+  return _stopSource.get();
 }
 inline stop_token jthread::get_stop_token() const noexcept {
-  return _stopSource.get_token();
+  return _stopSource.get().get_token();
+}
+
+inline ::std::size_t jthread::stack_high_water_mark() const noexcept {
+#ifdef JTHREAD_FUSED_START
+  return _thread.stackHighWaterMark();
+#else
+  return 0;
+#endif
 }
 
 inline void jthread::swap(jthread& t) noexcept {
-    std::swap(_stopSource, t._stopSource);
+    _stopSource.swap(t._stopSource);
     std::swap(_thread, t._thread);
 }
 
 
+//***************************************** 
+//* class __jthread_reaper
+//* - joins the jthreads passed to jthread::release_to_reaper()
+//*   in a background jthread (started on first use)
+//* - destroyed at process exit, after joining all threads still handed
+//*   over: from then on, release_to_reaper() joins in place
+//***************************************** 
+class __jthread_reaper
+{
+  public:
+    // (nullptr once destroyed at exit)
+    static __jthread_reaper* instance() {
+      if (gone().load(::std::memory_order_acquire)) {
+        return nullptr;
+      }
+      static __jthread_reaper reaper;
+      return &reaper;
+    }
+
+    // false if t has to be joined by the caller
+    bool adopt(jthread& t) noexcept {
+      {
+        ::std::lock_guard<::std::mutex> lg{_mutex};
+        if (_exiting) {
+          return false;
+        }
+        try {
+          _pending.push_back(::std::move(t));
+        }
+        catch (...) {
+          return false;
+        }
+      }
+      _cv.notify_one();
+      return true;
+    }
+
+    ~__jthread_reaper() {
+      gone().store(true, ::std::memory_order_release);
+      {
+        ::std::lock_guard<::std::mutex> lg{_mutex};
+        _exiting = true;
+      }
+      _cv.notify_one();
+      _thread.join();
+    }
+
+  private:
+    __jthread_reaper() = default;
+
+    static ::std::atomic<bool>& gone() noexcept {
+      static ::std::atomic<bool> flag{false};   // (trivially destructible)
+      return flag;
+    }
+
+    void run() {
+      ::std::unique_lock<::std::mutex> lock{_mutex};
+      for (;;) {
+        _cv.wait(lock, [this] { return !_pending.empty() || _exiting; });
+        if (_pending.empty()) {
+          return;                              // exiting and all joined
+        }
+        auto batch = ::std::move(_pending);
+        _pending.clear();
+        lock.unlock();
+        for (auto& t : batch) {
+          t.join();                            // (stop already requested)
+        }
+        batch.clear();
+        lock.lock();
+      }
+    }
+
+    ::std::mutex _mutex;
+    ::std::condition_variable _cv;
+    ::std::vector<jthread> _pending;
+    bool _exiting = false;
+    jthread _thread{[this] { run(); }};        // last: uses the members above
+};
+
+inline void jthread::release_to_reaper() {
+  if (!joinable()) {
+    return;
+  }
+  request_stop();
+  auto* reaper = __jthread_reaper::instance();
+  if (reaper == nullptr || !reaper->adopt(*this)) {
+    join();
+  }
+}
+
+
+//***************************************** 
+//* wait_any():
+//* - wait until one of the jthreads in [first, last) has finished and
+//*   return the first finished one (still joinable: join() it next)
+//* - sleeps until some jthread finishes, then checks again (no polling)
+//* - returns last if none of them is joinable
+//***************************************** 
+template <typename ForwardIt>
+ForwardIt wait_any(ForwardIt first, ForwardIt last) {
+  auto& signal = __jthread_exit_signal::instance();
+  struct Waiter {
+    __jthread_exit_signal& signal;
+    explicit Waiter(__jthread_exit_signal& s) noexcept : signal{s} {
+      signal.addWaiter();
+    }
+    ~Waiter() {
+      signal.removeWaiter();
+    }
+  } waiter{signal};
+  for (;;) {
+    auto epoch = signal.epoch();
+    bool anyJoinable = false;
+    for (auto it = first; it != last; ++it) {
+      const jthread& t = *it;
+      if (t.joinable()) {
+        if (t.finished()) {
+          return it;
+        }
+        anyJoinable = true;
+      }
+    }
+    if (!anyJoinable) {
+      return last;
+    }
+    signal.wait(epoch);
+  }
+}
+
+
 } // std
 
 #endif // JTHREAD_HPP
@@ -0,0 +1,223 @@
+// -----------------------------------------------------
+// groups of jthreads:
+// -----------------------------------------------------
+#ifndef JTHREAD_GROUP_HPP
+#define JTHREAD_GROUP_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace std {
+
+//*****************************************
+//* class jthread_group
+//* - owns a number of jthreads
+//* - spawn_n(n, f) starts n threads in a tree: the calling thread starts
+//*   thread 0, thread i starts threads 2i+1 and 2i+2 before it runs f
+//*   (n threads are up after about 2*log2(n) sequential thread starts
+//*   instead of n)
+//*   - each thread calls its own copy of f with (stop_token, index),
+//*     (stop_token), (index), or ()
+//*   - returns once all threads have started, with the time it took
+//*   - with wait_all_started, no thread runs f before all have started
+//*   - if a thread can't be started, the others are stopped and joined
+//*     and the exception is rethrown
+//* - stop_and_join() and the destructor request stop on all threads
+//*   before joining any, so shutdown takes as long as the slowest thread
+//*   to exit, not the sum of all of them (as with vector<jthread>)
+//* - not synchronized: use a group from one thread at a time
+//*****************************************
+class jthread_group {
+ public:
+  jthread_group() noexcept = default;
+  jthread_group(jthread_group&&) noexcept = default;
+  jthread_group& operator=(jthread_group&& __other) noexcept {
+    if (this != &__other) {
+      stop_and_join();
+      __threads_ = std::move(__other.__threads_);
+    }
+    return *this;
+  }
+  ~jthread_group() {
+    stop_and_join();
+  }
+
+  template <typename _Callable, typename... _Args>
+  jthread& emplace_back(_Callable&& __cb, _Args&&... __args) {
+    return __threads_.emplace_back(std::forward<_Callable>(__cb),
+                                   std::forward<_Args>(__args)...);
+  }
+
+  template <typename _Callable>
+  std::chrono::nanoseconds spawn_n(std::size_t __n, _Callable&& __cb,
+                                   bool __wait_all_started = false) {
+    const auto __start = std::chrono::steady_clock::now();
+    if (__n == 0) {
+      return std::chrono::nanoseconds{0};
+    }
+    const std::size_t __base = __threads_.size();
+    __threads_.resize(__base + __n);   // no reallocation while spawning
+    auto __spawn = std::make_shared<__spawn_state<std::decay_t<_Callable>>>(
+        *this, __base, __n, std::forward<_Callable>(__cb), __wait_all_started);
+    __spawn->__start_child(0);
+    __spawn->__wait();
+    if (__spawn->__error_ != nullptr) {
+      for (std::size_t __i = __base; __i < __threads_.size(); ++__i) {
+        __threads_[__i].request_stop();
+      }
+      for (std::size_t __i = __base; __i < __threads_.size(); ++__i) {
+        if (__threads_[__i].joinable()) {
+          __threads_[__i].join();
+        }
+      }
+      __threads_.resize(__base);
+      std::rethrow_exception(__spawn->__error_);
+    }
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        __spawn->__ready_ - __start);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    return __threads_.size();
+  }
+  [[nodiscard]] bool empty() const noexcept {
+    return __threads_.empty();
+  }
+  jthread& operator[](std::size_t __i) noexcept {
+    return __threads_[__i];
+  }
+  const jthread& operator[](std::size_t __i) const noexcept {
+    return __threads_[__i];
+  }
+  auto begin() noexcept { return __threads_.begin(); }
+  auto end() noexcept { return __threads_.end(); }
+
+  // request stop on all threads (without waiting)
+  void request_stop() noexcept {
+    for (auto& __t : __threads_) {
+      __t.request_stop();
+    }
+  }
+
+  // request stop on all threads, then join all of them (the group is empty
+  // afterwards)
+  void stop_and_join() {
+    request_stop();
+    for (auto& __t : __threads_) {
+      if (__t.joinable()) {
+        __t.join();
+      }
+    }
+    __threads_.clear();
+  }
+
+ private:
+  // shared by the threads of one spawn_n()
+  template <typename _Fn>
+  struct __spawn_state : std::enable_shared_from_this<__spawn_state<_Fn>> {
+    template <typename _CB>
+    __spawn_state(jthread_group& __group, std::size_t __base, std::size_t __n,
+                  _CB&& __cb, bool __barrier)
+     : __group_{__group}, __base_{__base}, __n_{__n},
+       __fn_{std::forward<_CB>(__cb)}, __barrier_{__barrier},
+       __pending_{2 * __n} {   // started and stored, per thread
+    }
+
+    // in the parent thread: start thread __i of the tree
+    void __start_child(std::size_t __i) {
+      try {
+        __group_.__threads_[__base_ + __i] =
+            jthread{[__self = this->shared_from_this(), __i, __fn = __fn_]
+                    (stop_token __st) mutable {
+                      __self->__run(__st, __i, __fn);
+                    }};
+        __count_down(1);   // stored
+      }
+      catch (...) {
+        {
+          std::lock_guard<std::mutex> __lock{__mutex_};
+          if (__error_ == nullptr) {
+            __error_ = std::current_exception();
+          }
+        }
+        // nobody else will count for this subtree
+        __count_down(2 * __subtree_size(__i));
+      }
+    }
+
+    void __run(const stop_token& __st, std::size_t __i, _Fn& __fn) {
+      for (std::size_t __child = 2 * __i + 1;
+           __child <= 2 * __i + 2 && __child < __n_; ++__child) {
+        __start_child(__child);
+      }
+      __count_down(1);   // started
+      if (__barrier_) {
+        __wait();
+        if (__error_ != nullptr) {
+          return;
+        }
+      }
+      if constexpr (std::is_invocable_v<_Fn&, stop_token, std::size_t>) {
+        __fn(__st, __i);
+      }
+      else if constexpr (std::is_invocable_v<_Fn&, stop_token>) {
+        __fn(__st);
+      }
+      else if constexpr (std::is_invocable_v<_Fn&, std::size_t>) {
+        __fn(__i);
+      }
+      else {
+        __fn();
+      }
+    }
+
+    std::size_t __subtree_size(std::size_t __i) const noexcept {
+      std::size_t __size = 0;
+      for (std::size_t __first = __i, __width = 1; __first < __n_;
+           __first = 2 * __first + 1, __width *= 2) {
+        __size += std::min(__width, __n_ - __first);
+      }
+      return __size;
+    }
+
+    void __count_down(std::size_t __k) {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      __pending_ -= __k;
+      if (__pending_ == 0) {
+        __ready_ = std::chrono::steady_clock::now();
+        __cv_.notify_all();
+      }
+    }
+
+    void __wait() {
+      std::unique_lock<std::mutex> __lock{__mutex_};
+      __cv_.wait(__lock, [this] { return __pending_ == 0; });
+    }
+
+    jthread_group& __group_;
+    const std::size_t __base_;
+    const std::size_t __n_;
+    const _Fn __fn_;   // copied into each thread
+    const bool __barrier_;
+    std::mutex __mutex_{};
+    std::condition_variable __cv_{};
+    std::size_t __pending_;
+    std::chrono::steady_clock::time_point __ready_{};
+    std::exception_ptr __error_{};
+  };
+
+  std::vector<jthread> __threads_{};
+};
+
+} // std
+
+#endif // JTHREAD_GROUP_HPP
@@ -0,0 +1,575 @@
+// -----------------------------------------------------
+// fixed-size pool of jthreads with stop tokens per task:
+// -----------------------------------------------------
+#ifndef JTHREAD_POOL_HPP
+#define JTHREAD_POOL_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include "condition_variable_any2.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace std {
+
+//*****************************************
+//* class __pool_task
+//* - type-erased move-only task with its stop_token
+//* - callables up to __inline_size bytes are stored in place
+//*   (no allocation per submit), larger ones on the heap
+//*****************************************
+class __pool_task {
+ public:
+  static constexpr std::size_t __inline_size = 6 * sizeof(void*);
+
+  __pool_task() noexcept = default;
+
+  template <typename _Callable>
+  __pool_task(_Callable&& __cb, stop_token __st)
+   : __token_{std::move(__st)},
+     __takesToken_{std::is_invocable_v<std::decay_t<_Callable>&, stop_token>} {
+    using _Fn = std::decay_t<_Callable>;
+    if constexpr (__fits_inline<_Fn>) {
+      ::new (static_cast<void*>(__storage_)) _Fn(std::forward<_Callable>(__cb));
+      __ops_ = &__inline_ops<_Fn>;
+    }
+    else {
+      *reinterpret_cast<_Fn**>(__storage_) = new _Fn(std::forward<_Callable>(__cb));
+      __ops_ = &__heap_ops<_Fn>;
+    }
+  }
+
+  __pool_task(__pool_task&& __t) noexcept
+   : __token_{std::move(__t.__token_)}, __takesToken_{__t.__takesToken_},
+     __ops_{std::exchange(__t.__ops_, nullptr)} {
+    if (__ops_ != nullptr) {
+      __ops_(__op::__move, this, &__t);
+    }
+  }
+  __pool_task& operator=(__pool_task&& __t) noexcept {
+    if (this != &__t) {
+      __reset();
+      __token_ = std::move(__t.__token_);
+      __takesToken_ = __t.__takesToken_;
+      __ops_ = std::exchange(__t.__ops_, nullptr);
+      if (__ops_ != nullptr) {
+        __ops_(__op::__move, this, &__t);
+      }
+    }
+    return *this;
+  }
+  ~__pool_task() {
+    __reset();
+  }
+
+  explicit operator bool() const noexcept {
+    return __ops_ != nullptr;
+  }
+
+  const stop_token& __token() const noexcept {
+    return __token_;
+  }
+
+  // the callable is called with a stop_token
+  bool __takes_token() const noexcept {
+    return __takesToken_;
+  }
+
+  // run and destroy the callable (exceptions terminate as with jthread)
+  void __run() noexcept {
+    __ops_(__op::__invoke, this, nullptr);
+    __reset();
+  }
+  // - passing __st instead of the task's token
+  void __run(stop_token __st) noexcept {
+    __token_ = std::move(__st);
+    __run();
+  }
+
+  void __reset() noexcept {
+    if (__ops_ != nullptr) {
+      std::exchange(__ops_, nullptr)(__op::__destroy, this, nullptr);
+    }
+  }
+
+ private:
+  enum class __op { __invoke, __move, __destroy };
+  using __ops_t = void (*)(__op, __pool_task*, __pool_task*);
+
+  template <typename _Fn>
+  static constexpr bool __fits_inline =
+      sizeof(_Fn) <= __inline_size &&
+      alignof(_Fn) <= alignof(std::max_align_t) &&
+      std::is_nothrow_move_constructible_v<_Fn>;
+
+  template <typename _Fn>
+  static void __call(_Fn& __fn, const stop_token& __st) {
+    if constexpr (std::is_invocable_v<_Fn&, stop_token>) {
+      __fn(__st);
+    }
+    else {
+      __fn();
+    }
+  }
+
+  template <typename _Fn>
+  static void __inline_ops(__op __o, __pool_task* __self, __pool_task* __src) {
+    auto* __fn = std::launder(reinterpret_cast<_Fn*>(__self->__storage_));
+    switch (__o) {
+      case __op::__invoke:
+        __call(*__fn, __self->__token_);
+        break;
+      case __op::__move: {
+        auto* __from = std::launder(reinterpret_cast<_Fn*>(__src->__storage_));
+        ::new (static_cast<void*>(__self->__storage_)) _Fn(std::move(*__from));
+        __from->~_Fn();
+        break;
+      }
+      case __op::__destroy:
+        __fn->~_Fn();
+        break;
+    }
+  }
+
+  template <typename _Fn>
+  static void __heap_ops(__op __o, __pool_task* __self, __pool_task* __src) {
+    auto*& __fn = *reinterpret_cast<_Fn**>(__self->__storage_);
+    switch (__o) {
+      case __op::__invoke:
+        __call(*__fn, __self->__token_);
+        break;
+      case __op::__move:
+        __fn = *reinterpret_cast<_Fn**>(__src->__storage_);
+        break;
+      case __op::__destroy:
+        delete __fn;
+        break;
+    }
+  }
+
+  stop_token __token_{};
+  bool __takesToken_ = false;
+  __ops_t __ops_ = nullptr;
+  alignas(std::max_align_t) unsigned char __storage_[__inline_size];
+};
+
+
+//*****************************************
+//* elastic_pool_options, jthread_pool_metrics:
+//* - elastic mode of jthread_pool: a worker is added when the queueing
+//*   delay of a task exceeds target_delay (up to max_workers), a worker
+//*   idle for idle_timeout retires (down to min_workers)
+//* - metrics() reports the resize decisions made so far
+//*****************************************
+struct elastic_pool_options {
+  std::size_t min_workers = 1;
+  std::size_t max_workers = jthread::hardware_concurrency();
+  std::chrono::microseconds target_delay{1000};
+  std::chrono::milliseconds idle_timeout{1000};
+};
+
+struct jthread_pool_metrics {
+  std::size_t workers = 0;          // current
+  std::size_t peak_workers = 0;
+  std::size_t grown = 0;            // workers added on queueing delay
+  std::size_t retired = 0;          // idle workers stopped
+  std::chrono::nanoseconds max_queue_delay{0};   // (elastic mode only)
+};
+
+
+//*****************************************
+//* class jthread_pool
+//* - jthread workers and one FIFO task queue
+//*   - fixed number of workers, or
+//*   - elastic (see elastic_pool_options): idle workers retire by a
+//*     request_stop() on their jthread
+//* - submit(f) calls f(stop_token) (or f() if it takes no token)
+//*   - with the pool's token, or
+//*   - with the token passed to submit(): when stop is requested on it,
+//*     a stop_callback unlinks the task from the queue in O(1) and
+//*     destroys it right away (instead of when a worker dequeues it);
+//*     once running, the task gets a token that is stopped by either
+//*     its own token or the pool's
+//* - idle workers block in condition_variable_any2::wait() on their
+//*   jthread's token (no polling); submit() only notifies if a worker
+//*   is idle
+//* - the queue is an intrusive list of nodes that are recycled via a free
+//*   list, so submitting small callables doesn't allocate once enough
+//*   nodes exist
+//* - request_stop() on the pool's token: running tasks see it, workers
+//*   don't start further tasks
+//* - destructor: request stop on the pool's token, join the workers
+//*   (blocks until running tasks return), and drop the queued tasks
+//*****************************************
+class jthread_pool {
+ public:
+  explicit jthread_pool(std::size_t __workers = jthread::hardware_concurrency()) {
+    if (__workers == 0) {
+      __workers = 1;
+    }
+    std::lock_guard<std::mutex> __lock{__mutex_};
+    __workers_.reserve(__workers);
+    while (__workers_.size() < __workers) {
+      __add_worker();
+    }
+  }
+
+  explicit jthread_pool(const elastic_pool_options& __options)
+   : __elastic_{true}, __options_{__options} {
+    __options_.min_workers = std::max<std::size_t>(__options_.min_workers, 1);
+    __options_.max_workers = std::max(__options_.max_workers, __options_.min_workers);
+    std::lock_guard<std::mutex> __lock{__mutex_};
+    __workers_.reserve(__options_.max_workers);
+    while (__workers_.size() < __options_.min_workers) {
+      __add_worker();
+    }
+  }
+
+  jthread_pool(const jthread_pool&) = delete;
+  jthread_pool& operator=(const jthread_pool&) = delete;
+
+  ~jthread_pool() {
+    __source_.request_stop();   // wakes idle workers, no more growing
+    std::vector<jthread> __workers;
+    jthread __retired;
+    {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      __workers.swap(__workers_);
+      __retired = std::move(__retired_);
+    }
+    __workers.clear();          // request stop and join
+    __retired = jthread{};
+    // drop the tasks not started
+    __node* __queued;
+    {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      __queued = std::exchange(__head_, nullptr);
+      __tail_ = nullptr;
+      for (__node* __n = __queued; __n != nullptr; __n = __n->__next) {
+        __n->__queued = false;   // (a concurrent cancel leaves it to us)
+      }
+    }
+    while (__queued != nullptr) {
+      __node* __n = std::exchange(__queued, __queued->__next);
+      __n->__cb.reset();
+      delete __n;
+    }
+    // wait for concurrent cancellations to recycle their nodes
+    for (;;) {
+      {
+        std::lock_guard<std::mutex> __lock{__mutex_};
+        if (__cancelling_ == 0) {
+          break;
+        }
+      }
+      std::this_thread::yield();
+    }
+    while (__free_ != nullptr) {
+      delete std::exchange(__free_, __free_->__next);
+    }
+  }
+
+  template <typename _Callable>
+  void submit(_Callable&& __cb) {
+    __pool_task __task{std::forward<_Callable>(__cb), __source_.get_token()};
+    bool __notify;
+    {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      __node* __n = __new_node();
+      __n->__task = std::move(__task);
+      __n->__ownToken = false;
+      __notify = __link(__n);
+    }
+    if (__notify) {
+      __ready_.notify_one();
+    }
+  }
+
+  template <typename _Callable>
+  void submit(_Callable&& __cb, stop_token __st) {
+    if (__st.stop_requested()) {
+      return;
+    }
+    __pool_task __task{std::forward<_Callable>(__cb), __st};
+    __node* __n;
+    {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      __n = __new_node();
+    }
+    __n->__task = std::move(__task);
+    __n->__cancelled = false;
+    __n->__ownToken = true;
+    // (executes inline if stop was requested meanwhile)
+    __n->__cb.emplace(std::move(__st), __cancel_t{this, __n});
+    {
+      std::unique_lock<std::mutex> __lock{__mutex_};
+      if (!__n->__cancelled) {
+        bool __notify = __link(__n);
+        __lock.unlock();
+        if (__notify) {
+          __ready_.notify_one();
+        }
+        return;
+      }
+    }
+    __reclaim(__n);
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    std::lock_guard<std::mutex> __lock{__mutex_};
+    return __workers_.size();
+  }
+
+  [[nodiscard]] jthread_pool_metrics metrics() const noexcept {
+    std::lock_guard<std::mutex> __lock{__mutex_};
+    jthread_pool_metrics __m = __metrics_;
+    __m.workers = __workers_.size();
+    return __m;
+  }
+
+  [[nodiscard]] stop_source get_stop_source() const noexcept {
+    return __source_;
+  }
+  [[nodiscard]] stop_token get_stop_token() const noexcept {
+    return __source_.get_token();
+  }
+  bool request_stop() noexcept {
+    return __source_.request_stop();
+  }
+
+ private:
+  struct __node;
+
+  struct __cancel_t {
+    jthread_pool* __pool;
+    __node* __n;
+    void operator()() noexcept {
+      __pool->__cancel(__n);
+    }
+  };
+
+  struct __node {
+    __pool_task __task{};
+    __node* __prev = nullptr;
+    __node* __next = nullptr;
+    bool __queued = false;
+    bool __cancelled = false;   // stop requested before it was queued
+    bool __ownToken = false;    // submitted with its own token
+    std::chrono::steady_clock::time_point __enqueued{};   // (elastic mode)
+    std::optional<stop_callback<__cancel_t>> __cb{};
+  };
+
+  // (lock is held)
+  __node* __new_node() {
+    if (__free_ == nullptr) {
+      return new __node;
+    }
+    return std::exchange(__free_, __free_->__next);
+  }
+
+  // (lock is held; the task and callback are destroyed)
+  void __free_node(__node* __n) noexcept {
+    __n->__next = std::exchange(__free_, __n);
+  }
+
+  // start a worker (lock is held)
+  void __add_worker() {
+    __workers_.emplace_back([this] (stop_token __st) { __work(__st); });
+    __metrics_.peak_workers = std::max(__metrics_.peak_workers, __workers_.size());
+  }
+
+  // elastic mode: add a worker if a task waited too long (lock is held)
+  void __maybe_grow(std::chrono::steady_clock::duration __delay) noexcept {
+    if (__delay > __metrics_.max_queue_delay) {
+      __metrics_.max_queue_delay =
+          std::chrono::duration_cast<std::chrono::nanoseconds>(__delay);
+    }
+    if (__delay <= __options_.target_delay || __idle_ > 0 ||
+        __workers_.size() >= __options_.max_workers ||
+        __source_.stop_requested()) {
+      return;
+    }
+    try {
+      __add_worker();
+      ++__metrics_.grown;
+    }
+    catch (...) {
+      // no new thread: keep the current workers
+    }
+  }
+
+  // elastic mode: let the calling idle worker retire (lock is held)
+  // - return the worker retired before (to join without the lock)
+  jthread __retire() noexcept {
+    const auto __id = std::this_thread::get_id();
+    for (auto& __w : __workers_) {
+      if (__w.get_id() == __id) {
+        jthread __previous = std::exchange(__retired_, std::move(__w));
+        __w = std::move(__workers_.back());
+        __workers_.pop_back();
+        __retired_.request_stop();
+        ++__metrics_.retired;
+        return __previous;
+      }
+    }
+    return jthread{};
+  }
+
+  // append to the queue (lock is held); return whether to notify
+  bool __link(__node* __n) noexcept {
+    if (__elastic_) {
+      __n->__enqueued = std::chrono::steady_clock::now();
+      if (__head_ != nullptr) {
+        __maybe_grow(__n->__enqueued - __head_->__enqueued);
+      }
+    }
+    __n->__prev = __tail_;
+    __n->__next = nullptr;
+    (__tail_ != nullptr ? __tail_->__next : __head_) = __n;
+    __tail_ = __n;
+    __n->__queued = true;
+    return __idle_ > 0;
+  }
+
+  // remove from the queue in O(1) (lock is held)
+  void __unlink(__node* __n) noexcept {
+    (__n->__prev != nullptr ? __n->__prev->__next : __head_) = __n->__next;
+    (__n->__next != nullptr ? __n->__next->__prev : __tail_) = __n->__prev;
+    __n->__queued = false;
+  }
+
+  // destroy the task and callback, recycle the node (lock is not held)
+  void __reclaim(__node* __n, bool __cancelled = false) noexcept {
+    __n->__task.__reset();
+    __n->__cb.reset();   // may be the executing callback, which is allowed
+    std::lock_guard<std::mutex> __lock{__mutex_};
+    __free_node(__n);
+    if (__cancelled) {
+      --__cancelling_;
+    }
+  }
+
+  // stop requested on the token of a task
+  void __cancel(__node* __n) noexcept {
+    {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      if (!__n->__queued) {
+        // not yet queued (submit() reclaims it) or already dequeued
+        __n->__cancelled = true;
+        return;
+      }
+      __unlink(__n);
+      ++__cancelling_;
+    }
+    __reclaim(__n, true);
+  }
+
+  void __work(const stop_token& __st) noexcept {
+    const stop_token __poolToken = __source_.get_token();
+    stop_source __linked{nostopstate};   // reused by __run_linked()
+    auto __ready = [&] {
+      return __head_ != nullptr || __poolToken.stop_requested();
+    };
+    std::unique_lock<std::mutex> __lock{__mutex_};
+    for (;;) {
+      if (__head_ == nullptr) {
+        ++__idle_;
+        if (__elastic_) {
+          __ready_.wait_for(__lock, __st, __options_.idle_timeout, __ready);
+        }
+        else {
+          __ready_.wait(__lock, __st, __ready);
+        }
+        --__idle_;
+      }
+      if (__st.stop_requested() || __poolToken.stop_requested()) {
+        break;
+      }
+      if (__head_ == nullptr) {
+        // idle for idle_timeout
+        if (__elastic_ && __workers_.size() > __options_.min_workers) {
+          jthread __previous = __retire();
+          __lock.unlock();
+          return;   // (__previous is joined)
+        }
+        continue;
+      }
+      __node* __n = __head_;
+      __unlink(__n);
+      if (__elastic_ && __head_ != nullptr) {
+        __maybe_grow(std::chrono::steady_clock::now() - __n->__enqueued);
+      }
+      __lock.unlock();
+      __n->__cb.reset();   // (waits for a concurrent __cancel())
+      if (!__n->__task.__token().stop_requested()) {
+        if (__n->__ownToken && __n->__task.__takes_token()) {
+          __run_linked(__n->__task, __poolToken, __linked);
+        }
+        else {
+          __n->__task.__run();
+        }
+      }
+      __n->__task.__reset();   // without the lock
+      __lock.lock();
+      __free_node(__n);
+    }
+  }
+
+  // run a task with its own token so that it also sees stop requests on
+  // the pool's token (the destructor's in particular)
+  // - __linked (per worker) is reused as long as nobody else refers to it
+  //   (no stop requested, no token kept by a previous task)
+  static void __run_linked(__pool_task& __task, const stop_token& __poolToken,
+                           stop_source& __linked) noexcept {
+    if (!__stop_source_access::__unshared(__linked)) {
+      try {
+        __linked = stop_source{};
+      }
+      catch (...) {
+        __linked = stop_source{nostopstate};
+        __task.__run();   // can't link: only its own token
+        return;
+      }
+    }
+    auto __forward = [&__linked] { __linked.request_stop(); };
+    stop_callback<decltype(__forward)> __fromTask{__task.__token(), __forward};
+    stop_callback<decltype(__forward)> __fromPool{__poolToken, __forward};
+    __task.__run(__linked.get_token());
+  }
+
+  struct __wake_all_t {
+    jthread_pool* __pool;
+    void operator()() noexcept {
+      // (lock: a worker is either waiting or sees the stop)
+      { std::lock_guard<std::mutex> __lock{__pool->__mutex_}; }
+      __pool->__ready_.notify_all();
+    }
+  };
+
+  stop_source __source_{};
+  mutable std::mutex __mutex_{};
+  condition_variable_any2 __ready_{};
+  stop_callback<__wake_all_t> __wakeOnStop_{__source_.get_token(), __wake_all_t{this}};
+  const bool __elastic_ = false;
+  elastic_pool_options __options_{};
+  jthread_pool_metrics __metrics_{};   // guarded by __mutex_
+  __node* __head_ = nullptr;           // FIFO queue
+  __node* __tail_ = nullptr;
+  __node* __free_ = nullptr;           // recycled nodes
+  std::size_t __idle_ = 0;
+  std::size_t __cancelling_ = 0;       // unlinked by __cancel(), not yet freed
+  std::vector<jthread> __workers_{};   // last: end before the queue
+  jthread __retired_{};                // joined by the next to retire
+};
+
+} // std
+
+#endif // JTHREAD_POOL_HPP
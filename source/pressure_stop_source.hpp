@@ -0,0 +1,196 @@
+// -----------------------------------------------------
+// load shedding: requesting stop under memory pressure:
+// -----------------------------------------------------
+#ifndef PRESSURE_STOP_SOURCE_HPP
+#define PRESSURE_STOP_SOURCE_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace std {
+
+//*****************************************
+//* pressure_thresholds:
+//* - when to request stop (0: not watched)
+//* - where to find the files (a fake procfs/cgroup directory for tests)
+//*****************************************
+struct pressure_thresholds {
+  std::size_t rss_bytes = 0;                    // <proc_root>/self/statm
+  std::size_t cgroup_bytes = 0;                 // <cgroup_root>/memory.current
+  // PSI trigger: "some" stall time per window
+  // (<cgroup_root>/memory.pressure or <proc_root>/pressure/memory)
+  std::chrono::microseconds psi_stall{0};
+  std::chrono::microseconds psi_window{std::chrono::seconds{1}};
+  std::chrono::milliseconds poll_interval{100}; // for RSS and cgroup usage
+  std::string proc_root = "/proc";
+  std::string cgroup_root = "/sys/fs/cgroup";
+};
+
+enum class pressure_reason { none, rss, cgroup, psi };
+
+
+//*****************************************
+//* class pressure_stop_source
+//* - one monitor jthread requests stop when a threshold is crossed
+//*   (instead of each worker polling its RSS)
+//* - waits for a PSI trigger where available (Linux >= 4.20) and polls the
+//*   usage files every poll_interval otherwise/in addition
+//* - the monitor ends once stop is requested (by it or via
+//*   get_stop_source()) or the object is destroyed
+//*****************************************
+class pressure_stop_source {
+ public:
+  explicit pressure_stop_source(pressure_thresholds __thresholds)
+   : __thresholds_{std::move(__thresholds)},
+     __monitor_{[this] (stop_token __st) { __run(__st); }} {
+  }
+
+  pressure_stop_source(const pressure_stop_source&) = delete;
+  pressure_stop_source& operator=(const pressure_stop_source&) = delete;
+
+  [[nodiscard]] stop_token get_token() const noexcept {
+    return __source_.get_token();
+  }
+
+  // e.g. to request stop for other reasons
+  [[nodiscard]] stop_source get_stop_source() const noexcept {
+    return __source_;
+  }
+
+  [[nodiscard]] bool stop_requested() const noexcept {
+    return __source_.stop_requested();
+  }
+
+  // the threshold that triggered the stop request (none if not triggered)
+  [[nodiscard]] pressure_reason reason() const noexcept {
+    return __reason_.load(std::memory_order_acquire);
+  }
+
+ private:
+  static bool __read_number(const std::string& __path, std::size_t __index,
+                            std::uint64_t& __value) {
+    std::ifstream __in{__path};
+    for (std::size_t __i = 0; __i <= __index; ++__i) {
+      if (!(__in >> __value)) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::size_t __rss_bytes() const {
+    std::uint64_t __pages;
+    if (!__read_number(__thresholds_.proc_root + "/self/statm", 1, __pages)) {
+      return 0;
+    }
+    return static_cast<std::size_t>(__pages) *
+           static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  }
+
+  std::size_t __cgroup_bytes() const {
+    std::uint64_t __bytes;
+    if (!__read_number(__thresholds_.cgroup_root + "/memory.current", 0, __bytes)) {
+      return 0;
+    }
+    return static_cast<std::size_t>(__bytes);
+  }
+
+  // register a PSI trigger; -1 if not available
+  int __open_psi_trigger() const {
+    if (__thresholds_.psi_stall.count() <= 0) {
+      return -1;
+    }
+    char __trigger[64];
+    int __len = std::snprintf(__trigger, sizeof(__trigger), "some %lld %lld",
+                              static_cast<long long>(__thresholds_.psi_stall.count()),
+                              static_cast<long long>(__thresholds_.psi_window.count()));
+    for (const auto& __path : {__thresholds_.cgroup_root + "/memory.pressure",
+                               __thresholds_.proc_root + "/pressure/memory"}) {
+      int __fd = ::open(__path.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+      if (__fd < 0) {
+        continue;
+      }
+      // the trigger lives as long as the fd (including the terminating '\0')
+      if (::write(__fd, __trigger, static_cast<std::size_t>(__len) + 1) >= 0) {
+        return __fd;
+      }
+      ::close(__fd);
+    }
+    return -1;
+  }
+
+  bool __check_usage() {
+    if (__thresholds_.rss_bytes > 0 && __rss_bytes() >= __thresholds_.rss_bytes) {
+      return __trigger(pressure_reason::rss);
+    }
+    if (__thresholds_.cgroup_bytes > 0 &&
+        __cgroup_bytes() >= __thresholds_.cgroup_bytes) {
+      return __trigger(pressure_reason::cgroup);
+    }
+    return false;
+  }
+
+  bool __trigger(pressure_reason __reason) {
+    __reason_.store(__reason, std::memory_order_release);
+    __source_.request_stop();
+    return true;
+  }
+
+  void __run(const stop_token& __st) {
+    const bool __pollUsage =
+        __thresholds_.rss_bytes > 0 || __thresholds_.cgroup_bytes > 0;
+    auto __token = __source_.get_token();
+    // wake up on destruction, on stop requested via get_stop_source(),
+    // and on PSI events:
+    ::pollfd __fds[3] = {{__st.native_eventfd(), POLLIN, 0},
+                         {__token.native_eventfd(), POLLIN, 0},
+                         {__open_psi_trigger(), POLLPRI, 0}};
+    ::nfds_t __nfds = __fds[2].fd >= 0 ? 3 : 2;
+    const int __timeout = !__pollUsage ? -1
+        : static_cast<int>(std::min<std::chrono::milliseconds::rep>(
+              __thresholds_.poll_interval.count(), INT_MAX));
+
+    while ((__pollUsage || __nfds == 3) &&
+           !__st.stop_requested() && !__token.stop_requested() &&
+           !__check_usage()) {
+      if (::poll(__fds, __nfds, __timeout) <= 0 || __nfds < 3) {
+        continue;
+      }
+      if ((__fds[2].revents & POLLPRI) != 0) {
+        __trigger(pressure_reason::psi);
+        break;
+      }
+      if ((__fds[2].revents & POLLERR) != 0) {
+        // the monitored cgroup went away: poll the usage only
+        ::close(__fds[2].fd);
+        __fds[2].fd = -1;
+        __nfds = 2;
+      }
+    }
+    if (__fds[2].fd >= 0) {
+      ::close(__fds[2].fd);
+    }
+  }
+
+  const pressure_thresholds __thresholds_;
+  stop_source __source_{};
+  std::atomic<pressure_reason> __reason_{pressure_reason::none};
+  jthread __monitor_;   // last: ends before the other members go away
+};
+
+} // std
+
+#endif // PRESSURE_STOP_SOURCE_HPP
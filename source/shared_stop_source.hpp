@@ -0,0 +1,249 @@
+// -----------------------------------------------------
+// cross-process stop state:
+// -----------------------------------------------------
+#ifndef SHARED_STOP_SOURCE_HPP
+#define SHARED_STOP_SOURCE_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <system_error>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace std {
+
+//*****************************************
+//* shared memory segment:
+//* - one 32-bit futex word:
+//*   bit 0: stop requested
+//*   bits 1..31: wake counter (to wake the local watcher thread
+//*               without requesting stop)
+//*****************************************
+struct __shared_stop_segment {
+  static_assert(std::atomic<std::uint32_t>::is_always_lock_free,
+                "futex word must be address-free");
+
+  static constexpr std::uint32_t __stop_requested_flag = 1u;
+  static constexpr std::uint32_t __wake_increment = 2u;
+
+  std::atomic<std::uint32_t> __word_{0};
+
+  std::uint32_t* __address() noexcept {
+    return reinterpret_cast<std::uint32_t*>(&__word_);
+  }
+
+  // no FUTEX_PRIVATE_FLAG: waiters may live in other processes
+  void __wait(std::uint32_t __expected) noexcept {
+    ::syscall(SYS_futex, __address(), FUTEX_WAIT, __expected,
+              nullptr, nullptr, 0);
+  }
+
+  void __wake_all() noexcept {
+    ::syscall(SYS_futex, __address(), FUTEX_WAKE, INT32_MAX,
+              nullptr, nullptr, 0);
+  }
+};
+
+
+//*****************************************
+//* process-local part of a shared_stop_source:
+//* - the mapping of the segment
+//* - a stop_source with the local callbacks
+//* - a lazily started watcher thread which requests stop on the local
+//*   stop_source when another process requests stop
+//*****************************************
+struct __shared_stop_block {
+  __shared_stop_segment* __segment_;
+  stop_source __local_{};
+  std::mutex __mutex_{};              // guards __watcher_ and __pid_
+  jthread* __watcher_ = nullptr;
+  ::pid_t __pid_ = ::getpid();
+
+  explicit __shared_stop_block(__shared_stop_segment* __segment) noexcept
+   : __segment_{__segment} {
+  }
+
+  ~__shared_stop_block() {
+    if (__pid_ == ::getpid()) {
+      delete __watcher_;              // wakes and joins the watcher
+    }
+    ::munmap(__segment_, sizeof(__shared_stop_segment));
+  }
+
+  __shared_stop_block(const __shared_stop_block&) = delete;
+  __shared_stop_block& operator=(const __shared_stop_block&) = delete;
+
+  bool __stop_requested() const noexcept {
+    return (__segment_->__word_.load(std::memory_order_acquire) &
+            __shared_stop_segment::__stop_requested_flag) != 0;
+  }
+
+  void __ensure_watcher() {
+    std::lock_guard<std::mutex> __guard{__mutex_};
+    if (__pid_ != ::getpid()) {
+      // forked: the watcher of the parent doesn't exist in this process,
+      // so its handle is abandoned (it can neither be joined nor detached)
+      __watcher_ = nullptr;
+      __pid_ = ::getpid();
+    }
+    if (__watcher_ == nullptr && !__local_.stop_requested()) {
+      __watcher_ = new jthread{[this] (stop_token __st) { __watch(__st); }};
+    }
+  }
+
+  void __watch(const stop_token& __st) noexcept {
+    auto* __segment = __segment_;
+    stop_callback __cb{__st, [__segment] {
+      __segment->__word_.fetch_add(__shared_stop_segment::__wake_increment,
+                                   std::memory_order_release);
+      __segment->__wake_all();
+    }};
+    for (;;) {
+      auto __word = __segment->__word_.load(std::memory_order_acquire);
+      if ((__word & __shared_stop_segment::__stop_requested_flag) != 0) {
+        __local_.request_stop();
+        return;
+      }
+      if (__st.stop_requested()) {
+        return;
+      }
+      __segment->__wait(__word);
+    }
+  }
+};
+
+
+//*****************************************
+//* class shared_stop_source
+//* - stop source shared by several processes:
+//*   - the stop flag and a futex word live in a shared memory segment
+//*     (an anonymous mapping inherited by fork() or a named POSIX
+//*     shared memory object)
+//*   - callbacks stay process-local: a request_stop() in another process
+//*     wakes a watcher thread that executes them in this process
+//*   - stop_requested() is a load of the shared flag
+//* - copies share the process-local part
+//*****************************************
+class shared_stop_source {
+ public:
+  // anonymous shared mapping, visible to processes forked afterwards
+  shared_stop_source()
+   : __block_{std::make_shared<__shared_stop_block>(__map(-1))} {
+  }
+
+  // named shared memory object (created if it doesn't exist yet)
+  explicit shared_stop_source(const char* __name)
+   : __block_{std::make_shared<__shared_stop_block>(__open(__name))} {
+  }
+
+  // remove a named shared memory object
+  // (existing mappings stay valid)
+  static bool unlink(const char* __name) noexcept {
+    return ::shm_unlink(__name) == 0;
+  }
+
+  // request stop in all processes:
+  // - executes the local callbacks on the calling thread
+  // - return: whether this call requested stop
+  bool request_stop() noexcept {
+    auto* __segment = __block_->__segment_;
+    auto __oldWord = __segment->__word_.fetch_or(
+        __shared_stop_segment::__stop_requested_flag, std::memory_order_acq_rel);
+    if ((__oldWord & __shared_stop_segment::__stop_requested_flag) != 0) {
+      return false;
+    }
+    __segment->__wake_all();
+    __block_->__local_.request_stop();
+    return true;
+  }
+
+  [[nodiscard]] bool stop_requested() const noexcept {
+    return __block_->__stop_requested();
+  }
+
+  // token for the local callbacks:
+  // - starts the watcher thread of this process if necessary
+  [[nodiscard]] stop_token get_token() {
+    __block_->__ensure_watcher();
+    if (__block_->__stop_requested()) {
+      // don't make the caller wait for the watcher
+      __block_->__local_.request_stop();
+    }
+    return __block_->__local_.get_token();
+  }
+
+  // block until stop is requested (in any process)
+  void wait() const noexcept {
+    auto* __segment = __block_->__segment_;
+    for (;;) {
+      auto __word = __segment->__word_.load(std::memory_order_acquire);
+      if ((__word & __shared_stop_segment::__stop_requested_flag) != 0) {
+        return;
+      }
+      __segment->__wait(__word);
+    }
+  }
+
+  [[nodiscard]] friend bool operator==(const shared_stop_source& __a,
+                                       const shared_stop_source& __b) noexcept {
+    return __a.__block_ == __b.__block_;
+  }
+  [[nodiscard]] friend bool operator!=(const shared_stop_source& __a,
+                                       const shared_stop_source& __b) noexcept {
+    return !(__a == __b);
+  }
+
+ private:
+  static __shared_stop_segment* __map(int __fd) {
+    void* __p = ::mmap(nullptr, sizeof(__shared_stop_segment),
+                       PROT_READ | PROT_WRITE,
+                       __fd < 0 ? MAP_SHARED | MAP_ANONYMOUS : MAP_SHARED,
+                       __fd, 0);
+    if (__p == MAP_FAILED) {
+      throw std::system_error{errno, std::system_category(), "mmap"};
+    }
+    // a fresh mapping is zero-filled, which is the initial state
+    return static_cast<__shared_stop_segment*>(__p);
+  }
+
+  static __shared_stop_segment* __open(const char* __name) {
+    int __fd = ::shm_open(__name, O_RDWR | O_CREAT, 0600);
+    if (__fd < 0) {
+      throw std::system_error{errno, std::system_category(), "shm_open"};
+    }
+    // growing (never shrinking) keeps the word of an existing object
+    struct ::stat __st;
+    if (::fstat(__fd, &__st) != 0 ||
+        (__st.st_size < static_cast<::off_t>(sizeof(__shared_stop_segment)) &&
+         ::ftruncate(__fd, sizeof(__shared_stop_segment)) != 0)) {
+      int __error = errno;
+      ::close(__fd);
+      throw std::system_error{__error, std::system_category(), "ftruncate"};
+    }
+    try {
+      auto* __segment = __map(__fd);
+      ::close(__fd);
+      return __segment;
+    }
+    catch (...) {
+      ::close(__fd);
+      throw;
+    }
+  }
+
+  std::shared_ptr<__shared_stop_block> __block_;
+};
+
+} // std
+
+#endif // SHARED_STOP_SOURCE_HPP
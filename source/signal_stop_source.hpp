@@ -0,0 +1,212 @@
+// -----------------------------------------------------
+// bridge from signals (SIGINT, SIGTERM, ...) to a stop_source:
+// -----------------------------------------------------
+#ifndef SIGNAL_STOP_SOURCE_HPP
+#define SIGNAL_STOP_SOURCE_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include <atomic>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <initializer_list>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+namespace std {
+
+//*****************************************
+//* state shared with the signal handler:
+//* - the handler only stores the signal number and writes to an eventfd,
+//*   both of which are async-signal-safe
+//* - the bridge thread (started lazily) reads the eventfd and performs
+//*   the real request_stop(), which may block and execute callbacks
+//*****************************************
+struct __signal_stop_bridge {
+  static_assert(std::atomic<int>::is_always_lock_free,
+                "signal number must be accessible from a signal handler");
+
+  std::atomic<int> __signal_{0};      // received signal (0: none yet)
+  int __eventfd_;
+  stop_source __source_{};
+  std::mutex __mutex_{};              // guards __thread_
+  jthread __thread_{};
+
+  struct __installed_handler {
+    int __signal;
+    struct ::sigaction __previous;
+  };
+  std::vector<__installed_handler> __handlers_{};
+
+  static inline std::atomic<__signal_stop_bridge*> __active_{nullptr};
+  // handlers (on any thread) that may still use the bridge they loaded
+  static inline std::atomic<int> __handlersRunning_{0};
+
+  __signal_stop_bridge()
+   : __eventfd_{::eventfd(0, EFD_CLOEXEC)} {
+    if (__eventfd_ < 0) {
+      throw std::system_error{errno, std::system_category(), "eventfd"};
+    }
+  }
+
+  ~__signal_stop_bridge() {
+    // end the thread before its eventfd goes away
+    if (__thread_.joinable()) {
+      __thread_.request_stop();
+      __thread_.join();
+    }
+    ::close(__eventfd_);
+  }
+
+  __signal_stop_bridge(const __signal_stop_bridge&) = delete;
+  __signal_stop_bridge& operator=(const __signal_stop_bridge&) = delete;
+
+  void __wake() noexcept {
+    std::uint64_t __one = 1;
+    // can only fail if the counter overflows, which still wakes the reader
+    [[maybe_unused]] auto __n = ::write(__eventfd_, &__one, sizeof(__one));
+  }
+
+  static void __handler(int __sig) noexcept {
+    int __savedErrno = errno;
+    // (seq_cst: either __uninstall() sees us running or we see nullptr)
+    __handlersRunning_.fetch_add(1);
+    auto* __bridge = __active_.load();
+    if (__bridge != nullptr) {
+      int __none = 0;
+      __bridge->__signal_.compare_exchange_strong(__none, __sig,
+                                                  std::memory_order_release);
+      __bridge->__wake();
+    }
+    __handlersRunning_.fetch_sub(1, std::memory_order_release);
+    errno = __savedErrno;
+  }
+
+  void __install(std::initializer_list<int> __signals) {
+    __signal_stop_bridge* __none = nullptr;
+    if (!__active_.compare_exchange_strong(__none, this,
+                                           std::memory_order_acq_rel)) {
+      throw std::system_error{EBUSY, std::system_category(),
+                              "signal_stop_source already exists"};
+    }
+    struct ::sigaction __action{};
+    __action.sa_handler = &__handler;
+    __action.sa_flags = SA_RESTART;
+    ::sigfillset(&__action.sa_mask);
+    for (int __sig : __signals) {
+      __installed_handler __installed{__sig, {}};
+      if (::sigaction(__sig, &__action, &__installed.__previous) != 0) {
+        int __error = errno;
+        __uninstall();
+        throw std::system_error{__error, std::system_category(), "sigaction"};
+      }
+      __handlers_.push_back(__installed);
+    }
+  }
+
+  void __uninstall() noexcept {
+    for (auto __it = __handlers_.rbegin(); __it != __handlers_.rend(); ++__it) {
+      ::sigaction(__it->__signal, &__it->__previous, nullptr);
+    }
+    __handlers_.clear();
+    __active_.store(nullptr);
+    // a handler on another thread may have loaded this bridge before:
+    // wait until it no longer uses it (e.g. the eventfd we close next)
+    while (__handlersRunning_.load(std::memory_order_acquire) != 0) {
+      std::this_thread::yield();
+    }
+  }
+
+  // forward a received signal (on the calling thread)
+  bool __forward() noexcept {
+    if (__signal_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
+    __source_.request_stop();
+    return true;
+  }
+
+  void __ensure_thread() {
+    std::lock_guard<std::mutex> __guard{__mutex_};
+    if (__thread_.joinable() || __source_.stop_requested()) {
+      return;
+    }
+    __thread_ = jthread{[this] (stop_token __st) {
+      // wake up to terminate without a signal:
+      stop_callback __cb{__st, [this] { __wake(); }};
+      for (;;) {
+        if (__forward() || __st.stop_requested()) {
+          return;
+        }
+        std::uint64_t __count;
+        [[maybe_unused]] auto __n = ::read(__eventfd_, &__count, sizeof(__count));
+      }
+    }};
+  }
+};
+
+
+//*****************************************
+//* class signal_stop_source
+//* - requests stop on a stop_source when one of the given signals arrives
+//*   (instead of a thread waiting in sigwait() just to forward it)
+//* - the signal handler is async-signal-safe; an internal jthread,
+//*   started by the first get_token()/get_stop_source(), performs
+//*   request_stop() and so executes the callbacks
+//* - installs the handlers on construction and restores the previous
+//*   ones on destruction (which waits for handlers still running on
+//*   other threads); at most one object may exist at a time
+//* - stop_requested() only reads the state: a received signal is
+//*   forwarded by the internal thread (or by get_token() before it runs)
+//*****************************************
+class signal_stop_source {
+ public:
+  explicit signal_stop_source(std::initializer_list<int> __signals = {SIGINT, SIGTERM})
+   : __bridge_{} {
+    __bridge_.__install(__signals);
+  }
+
+  ~signal_stop_source() {
+    __bridge_.__uninstall();
+  }
+
+  signal_stop_source(const signal_stop_source&) = delete;
+  signal_stop_source& operator=(const signal_stop_source&) = delete;
+
+  [[nodiscard]] stop_token get_token() {
+    return get_stop_source().get_token();
+  }
+
+  // e.g. to request stop for other reasons than a signal
+  [[nodiscard]] stop_source get_stop_source() {
+    __bridge_.__ensure_thread();
+    // a signal received before doesn't wait for the thread
+    __bridge_.__forward();
+    return __bridge_.__source_;
+  }
+
+  // (a received signal counts even if the bridge thread hasn't forwarded
+  // it yet; the callbacks run on that thread, not here)
+  [[nodiscard]] bool stop_requested() const noexcept {
+    return __bridge_.__signal_.load(std::memory_order_acquire) != 0 ||
+           __bridge_.__source_.stop_requested();
+  }
+
+  // the first signal received (0 if none)
+  [[nodiscard]] int signal() const noexcept {
+    return __bridge_.__signal_.load(std::memory_order_acquire);
+  }
+
+ private:
+  __signal_stop_bridge __bridge_;
+};
+
+} // std
+
+#endif // SIGNAL_STOP_SOURCE_HPP
@@ -0,0 +1,139 @@
+// -----------------------------------------------------
+// stop-aware blocking I/O:
+// -----------------------------------------------------
+#ifndef STOP_IO_HPP
+#define STOP_IO_HPP
+
+#include "stop_token.hpp"
+#include <cerrno>
+#include <vector>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace std {
+
+//*****************************************
+//* stoppable_read(), stoppable_write(), stoppable_accept(), stoppable_poll():
+//* - like the POSIX functions, but return early with -1 and
+//*   errno == ECANCELED when stop is requested
+//*   (before or while waiting; no self-pipe needed)
+//* - wait in poll() on the fd and the token's native_eventfd()
+//* - work with blocking and non-blocking fds
+//*   (non-blocking fds wait instead of failing with EAGAIN)
+//*****************************************
+
+// wait until __fd is ready for __events or stop is requested
+template <typename _Policy>
+int __stoppable_wait(int __fd, short __events,
+                     const basic_stop_token<_Policy>& __stoken) {
+  if (__stoken.stop_requested()) {
+    errno = ECANCELED;
+    return -1;
+  }
+  ::pollfd __fds[2] = {{__fd, __events, 0}, {-1, POLLIN, 0}};
+  ::nfds_t __nfds = 1;
+  if (__stoken.stop_possible()) {
+    __fds[1].fd = __stoken.native_eventfd();
+    __nfds = 2;
+  }
+  while (::poll(__fds, __nfds, -1) < 0) {
+    if (errno != EINTR) {
+      return -1;
+    }
+  }
+  if (__fds[1].revents != 0) {
+    errno = ECANCELED;
+    return -1;
+  }
+  return 0;
+}
+
+inline bool __is_retryable(int __error) noexcept {
+  return __error == EAGAIN || __error == EWOULDBLOCK || __error == EINTR;
+}
+
+template <typename _Policy>
+::ssize_t stoppable_read(int __fd, void* __buf, std::size_t __count,
+                         const basic_stop_token<_Policy>& __stoken) {
+  for (;;) {
+    if (__stoppable_wait(__fd, POLLIN, __stoken) < 0) {
+      return -1;
+    }
+    auto __n = ::read(__fd, __buf, __count);
+    if (__n >= 0 || !__is_retryable(errno)) {
+      return __n;
+    }
+  }
+}
+
+template <typename _Policy>
+::ssize_t stoppable_write(int __fd, const void* __buf, std::size_t __count,
+                          const basic_stop_token<_Policy>& __stoken) {
+  for (;;) {
+    if (__stoppable_wait(__fd, POLLOUT, __stoken) < 0) {
+      return -1;
+    }
+    auto __n = ::write(__fd, __buf, __count);
+    if (__n >= 0 || !__is_retryable(errno)) {
+      return __n;
+    }
+  }
+}
+
+template <typename _Policy>
+int stoppable_accept(int __fd, ::sockaddr* __addr, ::socklen_t* __addrlen,
+                     const basic_stop_token<_Policy>& __stoken) {
+  for (;;) {
+    if (__stoppable_wait(__fd, POLLIN, __stoken) < 0) {
+      return -1;
+    }
+    int __client = ::accept(__fd, __addr, __addrlen);
+    if (__client >= 0 || !(__is_retryable(errno) || errno == ECONNABORTED)) {
+      return __client;
+    }
+  }
+}
+
+// - return: number of ready fds as ::poll() (0 on timeout)
+template <typename _Policy>
+int stoppable_poll(::pollfd* __fds, ::nfds_t __nfds, int __timeout,
+                   const basic_stop_token<_Policy>& __stoken) {
+  if (__stoken.stop_requested()) {
+    errno = ECANCELED;
+    return -1;
+  }
+  if (!__stoken.stop_possible()) {
+    return ::poll(__fds, __nfds, __timeout);
+  }
+  // the fds and the eventfd (on the stack for up to 15 fds):
+  constexpr ::nfds_t __onStack = 16;
+  ::pollfd __local[__onStack];
+  std::vector<::pollfd> __heap;
+  ::pollfd* __all = __local;
+  if (__nfds >= __onStack) {
+    __heap.resize(__nfds + 1);
+    __all = __heap.data();
+  }
+  for (::nfds_t __i = 0; __i < __nfds; ++__i) {
+    __all[__i] = __fds[__i];
+  }
+  __all[__nfds] = {__stoken.native_eventfd(), POLLIN, 0};
+  int __ready = ::poll(__all, __nfds + 1, __timeout);
+  if (__ready < 0) {
+    return -1;
+  }
+  if (__all[__nfds].revents != 0) {
+    errno = ECANCELED;
+    return -1;
+  }
+  for (::nfds_t __i = 0; __i < __nfds; ++__i) {
+    __fds[__i].revents = __all[__i].revents;
+  }
+  return __ready;
+}
+
+} // std
+
+#endif // STOP_IO_HPP
@@ -0,0 +1,265 @@
+// -----------------------------------------------------
+// requesting stop on fd readiness, child exit, or timeouts:
+// -----------------------------------------------------
+#ifndef STOP_REACTOR_HPP
+#define STOP_REACTOR_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+namespace std {
+
+//*****************************************
+//* __stop_reactor:
+//* - one epoll instance and one (lazily started) jthread per process
+//*   for all triggers, instead of one thread per watched fd
+//* - a trigger requests stop on its stop_source once its fd is ready;
+//*   it is removed when it fires or when stop is requested otherwise
+//*   (via a stop_callback)
+//*****************************************
+class __stop_reactor {
+ public:
+  static __stop_reactor& __instance() {
+    static __stop_reactor __reactor;
+    return __reactor;
+  }
+
+  // register a trigger (takes ownership of __fd)
+  void __add(const stop_source& __source, int __fd, std::uint32_t __events) {
+    std::unique_ptr<__trigger_t> __trigger;
+    try {
+      __trigger = std::make_unique<__trigger_t>(__source, __fd);
+    }
+    catch (...) {
+      ::close(__fd);
+      throw;
+    }
+    const std::uint64_t __id = __trigger->__id_ = __nextId_++;
+
+    // deregisters the trigger if stop is requested otherwise
+    // (executes immediately if stop was already requested)
+    __trigger->__cb_.emplace(__source.get_token(), __cancel_t{this, __id});
+    if (__source.stop_requested()) {
+      return;
+    }
+
+    std::unique_lock<std::mutex> __lock{__mutex_};
+    ::epoll_event __event{};
+    __event.events = __events | EPOLLONESHOT;
+    __event.data.u64 = __id;
+    if (::epoll_ctl(__epollfd_, EPOLL_CTL_ADD, __fd, &__event) != 0) {
+      // (unlocks before __trigger is destroyed)
+      throw std::system_error{errno, std::system_category(), "epoll_ctl"};
+    }
+    __triggers_.emplace(__id, std::move(__trigger));
+    // a stop requested before the insertion didn't find the trigger:
+    if (__source.stop_requested()) {
+      auto __removed = __remove(__id);
+      __lock.unlock();
+      return;   // __removed is destroyed without holding the lock
+    }
+    if (!__thread_.joinable()) {
+      __thread_ = jthread{[this] (stop_token __st) { __run(__st); }};
+    }
+  }
+
+  __stop_reactor(const __stop_reactor&) = delete;
+  __stop_reactor& operator=(const __stop_reactor&) = delete;
+
+ private:
+  struct __cancel_t {
+    __stop_reactor* __reactor;
+    std::uint64_t __id;
+    void operator()() noexcept {
+      __reactor->__cancel(__id);
+    }
+  };
+
+  struct __trigger_t {
+    __trigger_t(const stop_source& __source, int __fd) noexcept
+     : __source_{__source}, __fd_{__fd} {
+    }
+    ~__trigger_t() {
+      __cb_.reset();
+      ::close(__fd_);
+    }
+    __trigger_t(const __trigger_t&) = delete;
+    __trigger_t& operator=(const __trigger_t&) = delete;
+
+    stop_source __source_;
+    int __fd_;
+    std::uint64_t __id_ = 0;
+    std::optional<stop_callback<__cancel_t>> __cb_{};
+  };
+
+  __stop_reactor()
+   : __epollfd_{::epoll_create1(EPOLL_CLOEXEC)},
+     __wakefd_{::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK)} {
+    if (__epollfd_ < 0 || __wakefd_ < 0) {
+      int __error = errno;
+      __close_fds();
+      throw std::system_error{__error, std::system_category(), "epoll_create1"};
+    }
+    ::epoll_event __event{};
+    __event.events = EPOLLIN;
+    __event.data.u64 = 0;   // trigger ids start at 1
+    ::epoll_ctl(__epollfd_, EPOLL_CTL_ADD, __wakefd_, &__event);
+  }
+
+  ~__stop_reactor() {
+    if (__thread_.joinable()) {
+      __thread_.request_stop();
+      __thread_.join();
+    }
+    // triggers deregister their callbacks before the fds are closed
+    __triggers_.clear();
+    __close_fds();
+  }
+
+  void __close_fds() noexcept {
+    if (__epollfd_ >= 0) {
+      ::close(__epollfd_);
+    }
+    if (__wakefd_ >= 0) {
+      ::close(__wakefd_);
+    }
+  }
+
+  // remove a trigger (lock is held); destroy the result without the lock
+  std::unique_ptr<__trigger_t> __remove(std::uint64_t __id) noexcept {
+    auto __pos = __triggers_.find(__id);
+    if (__pos == __triggers_.end()) {
+      return nullptr;
+    }
+    auto __trigger = std::move(__pos->second);
+    __triggers_.erase(__pos);
+    ::epoll_ctl(__epollfd_, EPOLL_CTL_DEL, __trigger->__fd_, nullptr);
+    return __trigger;
+  }
+
+  void __cancel(std::uint64_t __id) noexcept {
+    std::unique_ptr<__trigger_t> __trigger;
+    {
+      std::lock_guard<std::mutex> __lock{__mutex_};
+      __trigger = __remove(__id);
+    }
+    // may destroy the executing callback, which is allowed
+  }
+
+  void __run(const stop_token& __st) noexcept {
+    stop_callback __wake{__st, [this] {
+      std::uint64_t __one = 1;
+      [[maybe_unused]] auto __n = ::write(__wakefd_, &__one, sizeof(__one));
+    }};
+    ::epoll_event __events[64];
+    while (!__st.stop_requested()) {
+      int __n = ::epoll_wait(__epollfd_, __events, 64, -1);
+      for (int __i = 0; __i < __n; ++__i) {
+        if (__events[__i].data.u64 == 0) {
+          continue;   // __wakefd_
+        }
+        std::unique_ptr<__trigger_t> __trigger;
+        {
+          std::lock_guard<std::mutex> __lock{__mutex_};
+          __trigger = __remove(__events[__i].data.u64);
+        }
+        if (__trigger != nullptr) {
+          // executes the callbacks (including our __cancel_t) on this thread
+          __trigger->__source_.request_stop();
+        }
+      }
+    }
+  }
+
+  std::mutex __mutex_{};   // guards __triggers_ and __thread_ start
+  std::unordered_map<std::uint64_t, std::unique_ptr<__trigger_t>> __triggers_{};
+  std::atomic<std::uint64_t> __nextId_{1};
+  int __epollfd_;
+  int __wakefd_;
+  jthread __thread_{};
+};
+
+
+//*****************************************
+//* request_stop_on(), request_stop_on_exit(), request_stop_after():
+//* - request stop on __source when
+//*   - __fd is ready for __events (e.g. EPOLLIN: readable or hung up),
+//*   - child process __pid has exited (pidfd),
+//*   - __timeout has elapsed (timerfd)
+//* - all triggers share one reactor thread
+//* - a trigger is dropped once stop is requested on __source
+//* - __fd is duplicated, so the caller may close it at any time
+//* - throw std::system_error if the fd can't be created or watched
+//*****************************************
+
+inline void __request_stop_on_owned(const stop_source& __source, int __fd,
+                                    std::uint32_t __events) {
+  __stop_reactor* __reactor;
+  try {
+    __reactor = &__stop_reactor::__instance();
+  }
+  catch (...) {
+    ::close(__fd);
+    throw;
+  }
+  __reactor->__add(__source, __fd, __events);   // closes __fd on failure
+}
+
+inline void request_stop_on(const stop_source& __source, int __fd,
+                            std::uint32_t __events = EPOLLIN) {
+  int __dup = ::fcntl(__fd, F_DUPFD_CLOEXEC, 0);
+  if (__dup < 0) {
+    throw std::system_error{errno, std::system_category(), "fcntl"};
+  }
+  __request_stop_on_owned(__source, __dup, __events);
+}
+
+inline void request_stop_on_exit(const stop_source& __source, ::pid_t __pid) {
+  int __pidfd = static_cast<int>(::syscall(SYS_pidfd_open, __pid, 0));
+  if (__pidfd < 0) {
+    throw std::system_error{errno, std::system_category(), "pidfd_open"};
+  }
+  __request_stop_on_owned(__source, __pidfd, EPOLLIN);
+}
+
+template <typename _Rep, typename _Period>
+void request_stop_after(const stop_source& __source,
+                        const std::chrono::duration<_Rep, _Period>& __timeout) {
+  int __timerfd = ::timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+  if (__timerfd < 0) {
+    throw std::system_error{errno, std::system_category(), "timerfd_create"};
+  }
+  auto __ns = std::chrono::duration_cast<std::chrono::nanoseconds>(__timeout).count();
+  if (__ns <= 0) {
+    __ns = 1;   // 0 would disarm the timer
+  }
+  ::itimerspec __spec{};
+  __spec.it_value.tv_sec = static_cast<::time_t>(__ns / 1'000'000'000);
+  __spec.it_value.tv_nsec = static_cast<long>(__ns % 1'000'000'000);
+  if (::timerfd_settime(__timerfd, 0, &__spec, nullptr) != 0) {
+    int __error = errno;
+    ::close(__timerfd);
+    throw std::system_error{__error, std::system_category(), "timerfd_settime"};
+  }
+  __request_stop_on_owned(__source, __timerfd, EPOLLIN);
+}
+
+} // std
+
+#endif // STOP_REACTOR_HPP
@@ -1,13 +1,26 @@
 #pragma once
 // <stop_token> header
 
+#include <algorithm>
 #include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <new>
 #include <thread>
 #include <type_traits>
 #include <utility>
+#include <vector>
 #ifdef SAFE
 #include <iostream>
 #endif
+#ifdef __linux__
+#include <cerrno>
+#include <system_error>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 #if defined(__x86_64__) || defined(_M_X64)
 #include <immintrin.h>
@@ -22,17 +35,158 @@ inline void __spin_yield() noexcept {
 }
 
 
+//-----------------------------------------------
+// stop state policies
+//-----------------------------------------------
+// A policy for basic_stop_source<>, basic_stop_token<>, and
+// basic_stop_callback<> provides (all static):
+// - atomic_type<T>:          atomic (or single-threaded stand-in) for the
+//                            state word and the shard locks
+// - word_type, source_ref_shift:
+//                            refcount layout of the state word:
+//                            bit 0: stop-requested, bit 1: locked,
+//                            bit 2: has callbacks,
+//                            bits 3 .. shift-1: token ref count,
+//                            bits shift .. end: source ref count
+// - allocate(n), deallocate(p, n):
+//                            memory for the shared stop state
+// - backoff():               called when spinning on a lock or waiting for
+//                            a callback executing on another thread
+// - thread_id, this_thread_id():
+//                            identifies the thread that requested stop
+// - shard_hint():            per-thread number to spread registering
+//                            threads over the shards of a sharded state
+// Derive from default_stop_policy to replace only some of them.
+
+struct default_stop_policy {
+  template <typename _T>
+  using atomic_type = std::atomic<_T>;
+
+  using word_type = std::uint64_t;
+  static constexpr unsigned source_ref_shift = 33;  // 30/31 bits for the counts
+
+  static void* allocate(std::size_t __n) {
+    return ::operator new(__n);
+  }
+  static void deallocate(void* __p, std::size_t __n) noexcept {
+    ::operator delete(__p, __n);
+  }
+
+  static void backoff() noexcept {
+    __spin_yield();
+  }
+
+  using thread_id = std::thread::id;
+  static thread_id this_thread_id() noexcept {
+    return std::this_thread::get_id();
+  }
+
+  static std::uint32_t shard_hint() noexcept {
+    static std::atomic<std::uint32_t> __nextHint{0};
+    thread_local const std::uint32_t __hint =
+        __nextHint.fetch_add(1, std::memory_order_relaxed);
+    return __hint;
+  }
+};
+
+// for oversubscribed systems:
+// - waiting threads give up their time slice instead of spinning
+struct yielding_stop_policy : default_stop_policy {
+  static void backoff() noexcept {
+    std::this_thread::yield();
+  }
+};
+
+// plain value with the subset of the std::atomic<> interface
+// used by the stop state (memory orders are ignored)
+// - GCC >= 12 can't see that the reference counts keep the state alive
+//   when it inlines the non-atomic updates (false -Wuse-after-free)
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuse-after-free"
+#endif
+template <typename _T>
+class __unsynchronized_value {
+ public:
+  constexpr __unsynchronized_value(_T __value) noexcept : __value_(__value) {}
+
+  _T load(std::memory_order = std::memory_order_seq_cst) const noexcept {
+    return __value_;
+  }
+  void store(_T __value, std::memory_order = std::memory_order_seq_cst) noexcept {
+    __value_ = __value;
+  }
+  _T exchange(_T __value, std::memory_order = std::memory_order_seq_cst) noexcept {
+    return std::exchange(__value_, __value);
+  }
+  _T fetch_add(_T __value, std::memory_order = std::memory_order_seq_cst) noexcept {
+    return std::exchange(__value_, __value_ + __value);
+  }
+  _T fetch_sub(_T __value, std::memory_order = std::memory_order_seq_cst) noexcept {
+    return std::exchange(__value_, __value_ - __value);
+  }
+  _T fetch_or(_T __value, std::memory_order = std::memory_order_seq_cst) noexcept {
+    return std::exchange(__value_, __value_ | __value);
+  }
+  bool compare_exchange_weak(_T& __expected, _T __desired,
+                             std::memory_order = std::memory_order_seq_cst,
+                             std::memory_order = std::memory_order_seq_cst) noexcept {
+    if (__value_ != __expected) {
+      __expected = __value_;
+      return false;
+    }
+    __value_ = __desired;
+    return true;
+  }
+
+ private:
+  _T __value_;
+};
+#if defined(__GNUC__) && !defined(__clang__) && __GNUC__ >= 12
+#pragma GCC diagnostic pop
+#endif
+
+// for single-threaded code (e.g. event loops):
+// - all stop sources, tokens, and callbacks sharing a state
+//   must be used by the same thread
+// - plain integers instead of atomics (also in the callbacks),
+//   no thread identification, the lock is never contended,
+//   a sharded state uses only its first shard
+struct unsynchronized_stop_policy : default_stop_policy {
+  template <typename _T>
+  using atomic_type = __unsynchronized_value<_T>;
+
+  static void backoff() noexcept {
+  }
+
+  struct thread_id {
+    friend constexpr bool operator==(thread_id, thread_id) noexcept {
+      return true;
+    }
+  };
+  static thread_id this_thread_id() noexcept {
+    return {};
+  }
+
+  static std::uint32_t shard_hint() noexcept {
+    return 0;
+  }
+};
+
+
 //-----------------------------------------------
 // internal types for shared stop state
 //-----------------------------------------------
 
-struct __stop_callback_base {
-  void(*__callback_)(__stop_callback_base*) = nullptr;
+template <typename _Policy>
+struct __basic_stop_callback_base {
+  void(*__callback_)(__basic_stop_callback_base*) = nullptr;
 
-  __stop_callback_base* __next_ = nullptr;
-  __stop_callback_base** __prev_ = nullptr;
+  __basic_stop_callback_base* __next_ = nullptr;
+  __basic_stop_callback_base** __prev_ = nullptr;
   bool* __isRemoved_ = nullptr;
-  std::atomic<bool> __callbackFinishedExecuting_{false};
+  typename _Policy::template atomic_type<bool> __callbackFinishedExecuting_{false};
+  std::uint32_t __shard_ = 0;   // sub-list index in sharded mode
 
   void __execute() noexcept {
     __callback_(this);
@@ -41,11 +195,114 @@ struct __stop_callback_base {
  protected:
   // it shall only by us who deletes this
   // (workaround for virtual __execute() and destructor)
-  ~__stop_callback_base() = default;
+  ~__basic_stop_callback_base() = default;
+};
+
+// sub-list of callbacks with its own lock (for sharded stop states)
+template <typename _Policy>
+struct alignas(64) __basic_stop_shard {
+  using __stop_callback_base = __basic_stop_callback_base<_Policy>;
+
+  typename _Policy::template atomic_type<bool> __locked_{false};
+  __stop_callback_base* __head_ = nullptr;
+  // (guarded by __locked_:)
+  std::size_t __refs_ = 0;     // registered callbacks (incl. executed ones
+                               // not yet destroyed)
+  bool __holdsRef_ = false;    // shard holds one token reference for them
+  bool __draining_ = false;    // last source gone: drop it when __refs_ is 0
+
+  void __lock() noexcept {
+    while (__locked_.exchange(true, std::memory_order_acquire)) {
+      do {
+        _Policy::backoff();
+      } while (__locked_.load(std::memory_order_relaxed));
+    }
+  }
+
+  void __unlock() noexcept {
+    __locked_.store(false, std::memory_order_release);
+  }
 };
 
-struct __stop_state {
+template <typename _Policy>
+struct __basic_stop_state {
  public:
+  using __word_t = typename _Policy::word_type;
+  using __stop_callback_base = __basic_stop_callback_base<_Policy>;
+  using __shard_t = __basic_stop_shard<_Policy>;
+
+  __basic_stop_state() noexcept = default;
+
+  // sharded mode:
+  // - callbacks are registered in one of __shardCount sub-lists
+  //   (selected by a per-thread hint), each with its own lock,
+  //   so registration/deregistration doesn't contend on __state_
+  // - instead of one token reference per callback, each shard counts its
+  //   callbacks and holds a single token reference in __state_ from its
+  //   first registration until the last source is gone and its count
+  //   drops to 0 (see __drain_shards())
+  explicit __basic_stop_state(std::uint32_t __shardCount)
+   : __shardCount_(__shardCount > 0 ? __shardCount : 1) {
+    // with the memory of the policy, aligned by hand
+    // (allocate() only guarantees the default alignment)
+    void* __p = _Policy::allocate(__shard_bytes());
+    std::size_t __space = __shard_bytes();
+    __shardMemory_ = __p;
+    std::align(alignof(__shard_t), __shardCount_ * sizeof(__shard_t), __p, __space);
+    __shards_ = static_cast<__shard_t*>(__p);
+    for (std::uint32_t __i = 0; __i < __shardCount_; ++__i) {
+      ::new (static_cast<void*>(__shards_ + __i)) __shard_t{};
+    }
+  }
+
+  ~__basic_stop_state() {
+    if (__shards_ != nullptr) {
+      for (std::uint32_t __i = 0; __i < __shardCount_; ++__i) {
+        __shards_[__i].~__shard_t();
+      }
+      _Policy::deallocate(__shardMemory_, __shard_bytes());
+    }
+#ifdef __linux__
+    int __fd = __eventfd_.load(std::memory_order_relaxed);
+    if (__fd >= 0) {
+      ::close(__fd);
+    }
+#endif
+  }
+
+  __basic_stop_state(const __basic_stop_state&) = delete;
+  __basic_stop_state& operator=(const __basic_stop_state&) = delete;
+
+  // create/destroy with the memory of the policy:
+  template <typename... _Args>
+  static __basic_stop_state* __create(_Args... __args) {
+    void* __p = _Policy::allocate(sizeof(__basic_stop_state));
+    try {
+      return ::new (__p) __basic_stop_state(__args...);
+    }
+    catch (...) {
+      _Policy::deallocate(__p, sizeof(__basic_stop_state));
+      throw;
+    }
+  }
+
+  void __destroy() noexcept {
+    if (__release_ != nullptr) {
+      __release_(this);
+      return;
+    }
+    this->~__basic_stop_state();
+    _Policy::deallocate(this, sizeof(__basic_stop_state));
+  }
+
+  // for states embedded in a larger object (not created by __create()):
+  // __release() destroys and frees that object when the last reference
+  // goes away
+  using __release_t = void (*)(__basic_stop_state*) noexcept;
+  void __set_release(__release_t __release) noexcept {
+    __release_ = __release;
+  }
+
   void __add_token_reference() noexcept {
     __state_.fetch_add(__token_ref_increment, std::memory_order_relaxed);
   }
@@ -54,7 +311,7 @@ struct __stop_state {
     auto __oldState =
         __state_.fetch_sub(__token_ref_increment, std::memory_order_acq_rel);
     if (__oldState < (__token_ref_increment + __token_ref_increment)) {
-      delete this;
+      __destroy();
     }
   }
 
@@ -63,77 +320,105 @@ struct __stop_state {
   }
 
   void __remove_source_reference() noexcept {
+    if (__shards_ != nullptr) {
+      __remove_source_reference_sharded();
+      return;
+    }
     auto __oldState =
         __state_.fetch_sub(__source_ref_increment, std::memory_order_acq_rel);
     if (__oldState < (__token_ref_increment + __source_ref_increment)) {
-      delete this;
+      __destroy();
     }
   }
 
   bool __request_stop() noexcept {
+    if (__shards_ != nullptr) {
+      if (!__signal_stop_sharded()) {
+        return false;
+      }
+      __execute_callbacks_sharded();
+      return true;
+    }
 
-    if (!__try_lock_and_signal_until_signalled()) {
+    bool __hasCallbacks;
+    if (!__try_signal_and_lock_if_callbacks(__hasCallbacks)) {
       // Stop has already been requested.
       return false;
     }
 
-    // Set the 'stop_requested' signal and acquired the lock.
-
-    __signallingThread_ = std::this_thread::get_id();
-
-    while (__head_ != nullptr) {
-      // Dequeue the head of the queue
-      auto* __cb = __head_;
-      __head_ = __cb->__next_;
-      const bool anyMore = __head_ != nullptr;
-      if (anyMore) {
-        __head_->__prev_ = &__head_;
-      }
-      // Mark this item as removed from the list.
-      __cb->__prev_ = nullptr;
+    // Set the 'stop_requested' signal
+    // and acquired the lock if there are callbacks.
+    if (__hasCallbacks) {
+      __execute_callbacks_locked();
+    }
+    return true;
+  }
 
-      // Don't hold lock while executing callback
-      // so we don't block other threads from deregistering callbacks.
-      __unlock();
+  // two-phase stop request (see request_stop_all()):
+  // - __signal_stop() sets the 'stop_requested' signal (without taking
+  //   the lock) and returns whether this call did so
+  //   (__hasCallbacks: whether there is anything to do in phase 2)
+  // - __execute_callbacks() then executes the callbacks still registered
+  //   (on the calling thread); none can be added once the signal is set,
+  //   callbacks deregistered in between don't run
+  bool __signal_stop(bool& __hasCallbacks) noexcept {
+    if (__shards_ != nullptr) {
+      __hasCallbacks = true;   // unknown without locking all shards
+      return __signal_stop_sharded();
+    }
 
-      // TRICKY: Need to store a flag on the stack here that the callback
-      // can use to signal that the destructor was executed inline
-      // during the call. If the destructor was executed inline then
-      // it's not safe to dereference __cb after __execute() returns.
-      // If the destructor runs on some other thread then the other
-      // thread will block waiting for this thread to signal that the
-      // callback has finished executing.
-      bool __isRemoved = false;
-      __cb->__isRemoved_ = &__isRemoved;
+    return __try_signal_and_lock_if_callbacks(__hasCallbacks, false);
+  }
 
-      __cb->__execute();
+  void __execute_callbacks() noexcept {
+    if (__shards_ != nullptr) {
+      __execute_callbacks_sharded();
+      return;
+    }
 
-      if (!__isRemoved) {
-        __cb->__isRemoved_ = nullptr;
-        __cb->__callbackFinishedExecuting_.store(
-            true, std::memory_order_release);
-      }
+    __lock();
+    __execute_callbacks_locked();
+  }
 
-      if (!anyMore) {
-        // This was the last item in the queue when we dequeued it.
-        // No more items should be added to the queue after we have
-        // marked the state as interrupted, only removed from the queue.
-        // Avoid acquring/releasing the lock in this case.
-        return true;
+#ifdef __linux__
+  // eventfd that becomes (and stays) readable when stop is requested:
+  // - created on first use, owned by the state
+  int __native_eventfd() {
+    int __fd = __eventfd_.load(std::memory_order_acquire);
+    if (__fd >= 0) {
+      return __fd;
+    }
+    int __newFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (__newFd < 0) {
+      throw std::system_error{errno, std::system_category(), "eventfd"};
+    }
+    while (!__eventfd_.compare_exchange_weak(__fd, __newFd,
+                                             std::memory_order_acq_rel,
+                                             std::memory_order_acquire)) {
+      if (__fd >= 0) {
+        // created by another thread
+        ::close(__newFd);
+        return __fd;
       }
-
-      __lock();
     }
-
-    __unlock();
-
-    return true;
+    // Either the thread requesting stop sees the new eventfd or we see its
+    // 'stop_requested' signal (modifications of __state_ are totally ordered).
+    if (__is_stop_requested(__state_.fetch_or(0, std::memory_order_acq_rel))) {
+      __write_eventfd(__newFd);
+    }
+    return __newFd;
   }
+#endif
 
   bool __is_stop_requested() noexcept {
     return __is_stop_requested(__state_.load(std::memory_order_acquire));
   }
 
+  // only one source reference, nothing else (no stop, no callbacks)
+  bool __is_unshared() const noexcept {
+    return __state_.load(std::memory_order_acquire) == __source_ref_increment;
+  }
+
   bool __is_stop_requestable() noexcept {
     return __is_stop_requestable(__state_.load(std::memory_order_acquire));
   }
@@ -141,12 +426,16 @@ struct __stop_state {
   bool __try_add_callback(
       __stop_callback_base* __cb,
       bool __incrementRefCountIfSuccessful) noexcept {
-    std::uint64_t __oldState;
+    if (__shards_ != nullptr) {
+      return __try_add_callback_sharded(__cb, __incrementRefCountIfSuccessful);
+    }
+
+    __word_t __oldState;
     goto __load_state;
     do {
       goto __check_state;
       do {
-        __spin_yield();
+        _Policy::backoff();
       __load_state:
         __oldState = __state_.load(std::memory_order_acquire);
       __check_state:
@@ -158,7 +447,8 @@ struct __stop_state {
         }
       } while (__is_locked(__oldState));
     } while (!__state_.compare_exchange_weak(
-        __oldState, __oldState | __locked_flag, std::memory_order_acquire));
+        __oldState, __oldState | __locked_flag | __has_callbacks_flag,
+        std::memory_order_acquire));
 
     // Push callback onto callback list.
     __cb->__next_ = __head_;
@@ -179,15 +469,17 @@ struct __stop_state {
   }
 
   void __remove_callback(__stop_callback_base* __cb) noexcept {
+    if (__shards_ != nullptr) {
+      __remove_callback_sharded(__cb);
+      return;
+    }
+
     __lock();
 
     if (__cb->__prev_ != nullptr) {
       // Still registered, not yet executed
       // Just remove from the list.
-      *__cb->__prev_ = __cb->__next_;
-      if (__cb->__next_ != nullptr) {
-        __cb->__next_->__prev_ = __cb->__prev_;
-      }
+      __unlink(__cb);
 
       __unlock_and_decrement_token_ref_count();
 
@@ -196,10 +488,71 @@ struct __stop_state {
 
     __unlock();
 
+    __wait_until_executed(__cb);
+
+    __remove_token_reference();
+  }
+
+  // unregister a callback that is about to be relocated:
+  // - return true if __cb was still registered
+  //   (its token reference now belongs to the caller)
+  // - return false if __request_stop() has already dequeued it
+  //   (after it finished executing; the reference is released)
+  bool __try_detach_callback(__stop_callback_base* __cb) noexcept {
+    if (__shards_ != nullptr) {
+      return __try_detach_callback_sharded(__cb);
+    }
+
+    __lock();
+    const bool __registered = __cb->__prev_ != nullptr;
+    if (__registered) {
+      __unlink(__cb);
+    }
+    __unlock();
+    if (__registered) {
+      return true;
+    }
+
+    __wait_until_executed(__cb);
+    __remove_token_reference();
+    return false;
+  }
+
+ private:
+  static void __unlink(__stop_callback_base* __cb) noexcept {
+    *__cb->__prev_ = __cb->__next_;
+    if (__cb->__next_ != nullptr) {
+      __cb->__next_->__prev_ = __cb->__prev_;
+    }
+  }
+
+  // execute a callback that was dequeued by the signalling thread
+  // (without holding any lock)
+  static void __execute_dequeued(__stop_callback_base* __cb) noexcept {
+    // TRICKY: Need to store a flag on the stack here that the callback
+    // can use to signal that the destructor was executed inline
+    // during the call. If the destructor was executed inline then
+    // it's not safe to dereference __cb after __execute() returns.
+    // If the destructor runs on some other thread then the other
+    // thread will block waiting for this thread to signal that the
+    // callback has finished executing.
+    bool __isRemoved = false;
+    __cb->__isRemoved_ = &__isRemoved;
+
+    __cb->__execute();
+
+    if (!__isRemoved) {
+      __cb->__isRemoved_ = nullptr;
+      __cb->__callbackFinishedExecuting_.store(
+          true, std::memory_order_release);
+    }
+  }
+
+  void __wait_until_executed(__stop_callback_base* __cb) noexcept {
     // Callback has either already executed or is executing
     // concurrently on another thread.
 
-    if (__signallingThread_ == std::this_thread::get_id()) {
+    if (__signallingThread_ == _Policy::this_thread_id()) {
       // Callback executed on this thread or is still currently executing
       // and is deregistering itself from within the callback.
       if (__cb->__isRemoved_ != nullptr) {
@@ -213,52 +566,284 @@ struct __stop_state {
       // block until it finishes executing.
       while (
           !__cb->__callbackFinishedExecuting_.load(std::memory_order_acquire)) {
-        __spin_yield();
+        _Policy::backoff();
       }
     }
+  }
+
+  // execute the callbacks after setting 'stop_requested' (lock is held)
+  void __execute_callbacks_locked() noexcept {
+    __signallingThread_ = _Policy::this_thread_id();
+
+    while (__head_ != nullptr) {
+      // Dequeue the head of the queue
+      auto* __cb = __head_;
+      __head_ = __cb->__next_;
+      const bool anyMore = __head_ != nullptr;
+      if (anyMore) {
+        __head_->__prev_ = &__head_;
+      }
+      // Mark this item as removed from the list.
+      __cb->__prev_ = nullptr;
+
+      // Don't hold lock while executing callback
+      // so we don't block other threads from deregistering callbacks.
+      __unlock();
+
+      __execute_dequeued(__cb);
+
+      if (!anyMore) {
+        // This was the last item in the queue when we dequeued it.
+        // No more items should be added to the queue after we have
+        // marked the state as interrupted, only removed from the queue.
+        // Avoid acquring/releasing the lock in this case.
+        return;
+      }
+
+      __lock();
+    }
+
+    __unlock();
+  }
+
+  //*** sharded mode:
+
+  bool __signal_stop_sharded() noexcept {
+    // Set the 'stop_requested' signal; the shard locks order this
+    // against concurrent registrations (see __try_add_callback_sharded()).
+    auto __oldState =
+        __state_.fetch_or(__stop_requested_flag, std::memory_order_acq_rel);
+    if (__is_stop_requested(__oldState)) {
+      // Stop has already been requested.
+      return false;
+    }
+    __signal_eventfd();
+    return true;
+  }
+
+  void __execute_callbacks_sharded() noexcept {
+    __signallingThread_ = _Policy::this_thread_id();
+
+    for (std::uint32_t __i = 0; __i < __shardCount_; ++__i) {
+      auto& __shard = __shards_[__i];
+      __shard.__lock();
+      while (__shard.__head_ != nullptr) {
+        auto* __cb = __shard.__head_;
+        __shard.__head_ = __cb->__next_;
+        if (__shard.__head_ != nullptr) {
+          __shard.__head_->__prev_ = &__shard.__head_;
+        }
+        __cb->__prev_ = nullptr;
+        __shard.__unlock();
+
+        __execute_dequeued(__cb);
+
+        __shard.__lock();
+      }
+      __shard.__unlock();
+    }
+  }
+
+  bool __try_add_callback_sharded(
+      __stop_callback_base* __cb,
+      bool __incrementRefCountIfSuccessful) noexcept {
+    const std::uint32_t __index = _Policy::shard_hint() % __shardCount_;
+    auto& __shard = __shards_[__index];
+
+    __shard.__lock();
+    // Either __request_stop_sharded() has set the flag before we locked the
+    // shard (then we see it here), or it will lock the shard after us
+    // (then it sees the callback in the list).
+    auto __state = __state_.load(std::memory_order_acquire);
+    if (__is_stop_requested(__state)) {
+      __shard.__unlock();
+      __cb->__execute();
+      return false;
+    } else if (!__is_stop_requestable(__state)) {
+      __shard.__unlock();
+      return false;
+    }
+
+    __cb->__shard_ = __index;
+    __cb->__next_ = __shard.__head_;
+    if (__cb->__next_ != nullptr) {
+      __cb->__next_->__prev_ = &__cb->__next_;
+    }
+    __cb->__prev_ = &__shard.__head_;
+    __shard.__head_ = __cb;
+
+    // the callback's reference is counted in the shard;
+    // only the first one of a shard touches __state_
+    ++__shard.__refs_;
+    if (!__shard.__holdsRef_) {
+      __shard.__holdsRef_ = true;
+      __add_token_reference();
+    }
+    __shard.__unlock();
 
+    if (!__incrementRefCountIfSuccessful) {
+      // the reference we were handed is covered by the shard's one now
+      // (so this can't be the last one)
+      __remove_token_reference();
+    }
+
+    // Successfully added the callback.
+    return true;
+  }
+
+  void __remove_callback_sharded(__stop_callback_base* __cb) noexcept {
+    auto& __shard = __shards_[__cb->__shard_];
+    __shard.__lock();
+
+    if (__cb->__prev_ != nullptr) {
+      // Still registered, not yet executed
+      // Just remove from the list.
+      __unlink(__cb);
+    }
+    else {
+      __shard.__unlock();
+      __wait_until_executed(__cb);
+      __shard.__lock();
+    }
+
+    __release_shard_ref_and_unlock(__shard);
+  }
+
+  bool __try_detach_callback_sharded(__stop_callback_base* __cb) noexcept {
+    auto& __shard = __shards_[__cb->__shard_];
+    __shard.__lock();
+    const bool __registered = __cb->__prev_ != nullptr;
+    if (__registered) {
+      __unlink(__cb);
+      // the caller gets a reference of its own
+      // (while the shard's one keeps the state alive)
+      __add_token_reference();
+    }
+    else {
+      __shard.__unlock();
+      __wait_until_executed(__cb);
+      __shard.__lock();
+    }
+    __release_shard_ref_and_unlock(__shard);
+    return __registered;
+  }
+
+  // drop the reference of one callback of __shard (locked)
+  // and the shard's token reference if it was the last one after draining
+  void __release_shard_ref_and_unlock(
+      __shard_t& __shard) noexcept {
+    const bool __dropRef = --__shard.__refs_ == 0 && __shard.__draining_;
+    if (__dropRef) {
+      __shard.__holdsRef_ = false;
+    }
+    __shard.__unlock();
+    if (__dropRef) {
+      __remove_token_reference();
+    }
+  }
+
+  void __remove_source_reference_sharded() noexcept {
+    // keep the state alive while draining the shards
+    // (their references may be the only ones left)
+    __add_token_reference();
+    auto __oldState =
+        __state_.fetch_sub(__source_ref_increment, std::memory_order_acq_rel);
+    if (__oldState < (__source_ref_increment + __source_ref_increment)) {
+      __drain_shards();
+    }
     __remove_token_reference();
   }
 
- private:
-  static bool __is_locked(std::uint64_t __state) noexcept {
+  // the last source is gone, so no callback can be registered any more
+  // (__try_add_callback_sharded() sees it under the shard lock):
+  // - let each shard drop its token reference once it has no callbacks
+  void __drain_shards() noexcept {
+    for (std::uint32_t __i = 0; __i < __shardCount_; ++__i) {
+      auto& __shard = __shards_[__i];
+      __shard.__lock();
+      __shard.__draining_ = true;
+      const bool __dropRef = __shard.__holdsRef_ && __shard.__refs_ == 0;
+      if (__dropRef) {
+        __shard.__holdsRef_ = false;
+      }
+      __shard.__unlock();
+      if (__dropRef) {
+        __remove_token_reference();
+      }
+    }
+  }
+
+  std::size_t __shard_bytes() const noexcept {
+    return __shardCount_ * sizeof(__shard_t) + alignof(__shard_t) - 1;
+  }
+
+  static bool __is_locked(__word_t __state) noexcept {
     return (__state & __locked_flag) != 0;
   }
 
-  static bool __is_stop_requested(std::uint64_t __state) noexcept {
+  static bool __is_stop_requested(__word_t __state) noexcept {
     return (__state & __stop_requested_flag) != 0;
   }
 
-  static bool __is_stop_requestable(std::uint64_t __state) noexcept {
+  static bool __has_callbacks(__word_t __state) noexcept {
+    return (__state & __has_callbacks_flag) != 0;
+  }
+
+  static bool __is_stop_requestable(__word_t __state) noexcept {
     // Interruptible if it has already been interrupted or if there are
     // still interrupt_source instances in existence.
     return __is_stop_requested(__state) || (__state >= __source_ref_increment);
   }
 
-  bool __try_lock_and_signal_until_signalled() noexcept {
-    std::uint64_t __oldState = __state_.load(std::memory_order_acquire);
+  // set the 'stop_requested' signal and, if there are callbacks and
+  // __lockIfCallbacks, acquire the lock (so without callbacks this is
+  // one CAS)
+  bool __try_signal_and_lock_if_callbacks(bool& __hasCallbacks,
+                                          bool __lockIfCallbacks = true) noexcept {
+    __word_t __oldState = __state_.load(std::memory_order_acquire);
     do {
       if (__is_stop_requested(__oldState))
         return false;
       while (__is_locked(__oldState)) {
-        __spin_yield();
+        _Policy::backoff();
         __oldState = __state_.load(std::memory_order_acquire);
         if (__is_stop_requested(__oldState))
           return false;
       }
     } while (!__state_.compare_exchange_weak(
         __oldState,
-        __oldState | __stop_requested_flag | __locked_flag,
+        __oldState | __stop_requested_flag |
+            (__lockIfCallbacks && __has_callbacks(__oldState) ? __locked_flag : 0),
         std::memory_order_acq_rel,
         std::memory_order_acquire));
+    __hasCallbacks = __has_callbacks(__oldState);
+    __signal_eventfd();
     return true;
   }
 
+  // wake the pollers of __native_eventfd() (if any)
+  void __signal_eventfd() noexcept {
+#ifdef __linux__
+    int __fd = __eventfd_.load(std::memory_order_acquire);
+    if (__fd >= 0) {
+      __write_eventfd(__fd);
+    }
+#endif
+  }
+
+#ifdef __linux__
+  static void __write_eventfd(int __fd) noexcept {
+    std::uint64_t __one = 1;
+    // can only fail if the counter overflows, which keeps it readable
+    [[maybe_unused]] auto __n = ::write(__fd, &__one, sizeof(__one));
+  }
+#endif
+
   void __lock() noexcept {
     auto __oldState = __state_.load(std::memory_order_relaxed);
     do {
       while (__is_locked(__oldState)) {
-        __spin_yield();
+        _Policy::backoff();
         __oldState = __state_.load(std::memory_order_relaxed);
       }
     } while (!__state_.compare_exchange_weak(
@@ -268,8 +853,18 @@ struct __stop_state {
         std::memory_order_relaxed));
   }
 
+  // while locked, only we modify the 'has callbacks' bit:
+  // - set when a callback is added
+  // - cleared on unlock if the list has become empty
+  __word_t __has_callbacks_flag_to_clear() noexcept {
+    return (__head_ == nullptr &&
+            __has_callbacks(__state_.load(std::memory_order_relaxed)))
+        ? __has_callbacks_flag : 0;
+  }
+
   void __unlock() noexcept {
-    __state_.fetch_sub(__locked_flag, std::memory_order_release);
+    __state_.fetch_sub(__locked_flag + __has_callbacks_flag_to_clear(),
+                       std::memory_order_release);
   }
 
   void __unlock_and_increment_token_ref_count() noexcept {
@@ -279,90 +874,142 @@ struct __stop_state {
 
   void __unlock_and_decrement_token_ref_count() noexcept {
     auto __oldState = __state_.fetch_sub(
-        __locked_flag + __token_ref_increment, std::memory_order_acq_rel);
+        __locked_flag + __has_callbacks_flag_to_clear() + __token_ref_increment,
+        std::memory_order_acq_rel);
     // Check if new state is less than __token_ref_increment which would
     // indicate that this was the last reference.
     if (__oldState <
         (__locked_flag + __token_ref_increment + __token_ref_increment)) {
-      delete this;
+      __destroy();
     }
   }
 
-  static constexpr std::uint64_t __stop_requested_flag = 1u;
-  static constexpr std::uint64_t __locked_flag = 2u;
-  static constexpr std::uint64_t __token_ref_increment = 4u;
-  static constexpr std::uint64_t __source_ref_increment =
-      static_cast<std::uint64_t>(1u) << 33u;
+  static constexpr __word_t __stop_requested_flag = 1u;
+  static constexpr __word_t __locked_flag = 2u;
+  static constexpr __word_t __has_callbacks_flag = 4u;
+  static constexpr __word_t __token_ref_increment = 8u;
+  static constexpr __word_t __source_ref_increment =
+      static_cast<__word_t>(1u) << _Policy::source_ref_shift;
+
+  static_assert(_Policy::source_ref_shift > 3 &&
+                _Policy::source_ref_shift < sizeof(__word_t) * 8,
+                "token and source ref counts need at least one bit each");
 
   // bit 0 - stop-requested
   // bit 1 - locked
-  // bits 2-32 - token ref count (31 bits)
-  // bits 33-63 - source ref count (31 bits)
-  std::atomic<std::uint64_t> __state_{__source_ref_increment};
+  // bit 2 - has callbacks (non-sharded mode only, __head_ != nullptr)
+  // bits 3-32 - token ref count (30 bits with the default policy)
+  // bits 33-63 - source ref count (31 bits with the default policy)
+  // the has-callbacks bit lives in this word (instead of a separate
+  // member) so that signalling stop can see in the same CAS whether the
+  // lock is needed at all; that costs the token count one bit, which
+  // still allows about 10^9 tokens (and registered callbacks, which hold
+  // a token reference each) per state
+  typename _Policy::template atomic_type<__word_t> __state_{__source_ref_increment};
   __stop_callback_base* __head_ = nullptr;
-  std::thread::id __signallingThread_{};
+  typename _Policy::thread_id __signallingThread_{};
+  __shard_t* __shards_ = nullptr;   // non-null in sharded mode
+  std::uint32_t __shardCount_ = 0;
+  void* __shardMemory_ = nullptr;     // allocated for __shards_
+  __release_t __release_ = nullptr;   // see __set_release()
+#ifdef __linux__
+  typename _Policy::template atomic_type<int> __eventfd_{-1};   // see __native_eventfd()
+#endif
 };
 
+using __stop_state = __basic_stop_state<default_stop_policy>;
+
 
 //-----------------------------------------------
 // forward declarations
 //-----------------------------------------------
 
-class stop_source;
+template <typename _Policy>
+class basic_stop_token;
+template <typename _Policy>
+class basic_stop_source;
+template <typename _Callback, typename _Policy>
+class basic_stop_callback;
 template <typename _Callback>
 class stop_callback;
+template <typename _Callback, typename _Policy>
+class relocatable_stop_callback;
+
+using stop_token = basic_stop_token<default_stop_policy>;
+using stop_source = basic_stop_source<default_stop_policy>;
+
+// callback type of basic_stop_token<_Policy>:
+template <typename _Callback, typename _Policy>
+struct __stop_callback_type {
+  using type = basic_stop_callback<_Callback, _Policy>;
+};
+template <typename _Callback>
+struct __stop_callback_type<_Callback, default_stop_policy> {
+  using type = stop_callback<_Callback>;
+};
 
 // std::nostopstate
 // - to initialize a stop_source without shared stop state
 struct nostopstate_t { explicit nostopstate_t() = default; };
 inline constexpr nostopstate_t nostopstate{};
 
+// std::sharded_stop_state
+// - to initialize a stop_source whose callback list is split into
+//   per-thread sub-lists (for sources shared by many threads)
+struct sharded_stop_state_t { explicit sharded_stop_state_t() = default; };
+inline constexpr sharded_stop_state_t sharded_stop_state{};
+
 
 //-----------------------------------------------
-// stop_token
+// basic_stop_token / stop_token
 //-----------------------------------------------
 
-class stop_token {
+template <typename _Policy>
+class basic_stop_token {
  public:
+  // associated callback type (see stop_callback_for_t<>):
+  template <typename _Callback>
+  using callback_type = typename __stop_callback_type<_Callback, _Policy>::type;
+
   // construct:
   // - TODO: explicit?
-  stop_token() noexcept
+  basic_stop_token() noexcept
    : __state_(nullptr) {
   }
 
   // copy/move/assign/destroy:
-  stop_token(const stop_token& __it) noexcept
+  basic_stop_token(const basic_stop_token& __it) noexcept
    : __state_(__it.__state_) {
     if (__state_ != nullptr) {
       __state_->__add_token_reference();
     }
   }
 
-  stop_token(stop_token&& __it) noexcept
+  basic_stop_token(basic_stop_token&& __it) noexcept
    : __state_(std::exchange(__it.__state_, nullptr)) {
   }
 
-  ~stop_token() {
+  ~basic_stop_token() {
     if (__state_ != nullptr) {
       __state_->__remove_token_reference();
     }
   }
 
-  stop_token& operator=(const stop_token& __it) noexcept {
+  basic_stop_token& operator=(const basic_stop_token& __it) noexcept {
     if (__state_ != __it.__state_) {
-      stop_token __tmp{__it};
+      basic_stop_token __tmp{__it};
       swap(__tmp);
     }
     return *this;
   }
 
-  stop_token& operator=(stop_token&& __it) noexcept {
-    stop_token __tmp{std::move(__it)};
+  basic_stop_token& operator=(basic_stop_token&& __it) noexcept {
+    basic_stop_token __tmp{std::move(__it)};
     swap(__tmp);
     return *this;
   }
 
-  void swap(stop_token& __it) noexcept {
+  void swap(basic_stop_token& __it) noexcept {
     std::swap(__state_, __it.__state_);
   }
 
@@ -375,67 +1022,87 @@ class stop_token {
     return __state_ != nullptr && __state_->__is_stop_requestable();
   }
 
+#ifdef __linux__
+  // eventfd that becomes readable when stop is requested
+  // (for poll()/epoll; -1 without a stop state):
+  // - created lazily, once per stop state, and owned by it
+  // - never read it (the readiness would be consumed)
+  // - throws std::system_error if it can't be created
+  [[nodiscard]] int native_eventfd() const {
+    return __state_ != nullptr ? __state_->__native_eventfd() : -1;
+  }
+#endif
+
   [[nodiscard]] friend bool operator==(
-      const stop_token& __a,
-      const stop_token& __b) noexcept {
+      const basic_stop_token& __a,
+      const basic_stop_token& __b) noexcept {
     return __a.__state_ == __b.__state_;
   }
   [[nodiscard]] friend bool operator!=(
-      const stop_token& __a,
-      const stop_token& __b) noexcept {
+      const basic_stop_token& __a,
+      const basic_stop_token& __b) noexcept {
     return __a.__state_ != __b.__state_;
   }
 
  private:
-  friend class stop_source;
-  template <typename _Callback>
-  friend class stop_callback;
+  friend class basic_stop_source<_Policy>;
+  template <typename, typename>
+  friend class basic_stop_callback;
+  template <typename, typename>
+  friend class relocatable_stop_callback;
 
-  explicit stop_token(__stop_state* __state) noexcept : __state_(__state) {
+  explicit basic_stop_token(__basic_stop_state<_Policy>* __state) noexcept : __state_(__state) {
     if (__state_ != nullptr) {
       __state_->__add_token_reference();
     }
   }
 
-  __stop_state* __state_;
+  __basic_stop_state<_Policy>* __state_;
 };
 
 
 //-----------------------------------------------
-// stop_source
+// basic_stop_source / stop_source
 //-----------------------------------------------
 
-class stop_source {
+template <typename _Policy>
+class basic_stop_source {
  public:
-  stop_source() : __state_(new __stop_state()) {}
+  basic_stop_source()
+   : __state_(__basic_stop_state<_Policy>::__create()) {}
 
-  explicit stop_source(std::nostopstate_t) noexcept : __state_(nullptr) {}
+  explicit basic_stop_source(std::nostopstate_t) noexcept : __state_(nullptr) {}
 
-  ~stop_source() {
+  // - shards == 0 uses one shard per hardware thread
+  explicit basic_stop_source(std::sharded_stop_state_t, unsigned __shards = 0)
+   : __state_(__basic_stop_state<_Policy>::__create(static_cast<std::uint32_t>(
+         __shards != 0 ? __shards : std::thread::hardware_concurrency()))) {}
+
+  ~basic_stop_source() {
     if (__state_ != nullptr) {
       __state_->__remove_source_reference();
     }
   }
 
-  stop_source(const stop_source& __other) noexcept
+  basic_stop_source(const basic_stop_source& __other) noexcept
       : __state_(__other.__state_) {
     if (__state_ != nullptr) {
       __state_->__add_source_reference();
     }
   }
 
-  stop_source(stop_source&& __other) noexcept
+  basic_stop_source(basic_stop_source&& __other) noexcept
       : __state_(std::exchange(__other.__state_, nullptr)) {}
 
-  stop_source& operator=(stop_source&& __other) noexcept {
-    stop_source __tmp{std::move(__other)};
+  basic_stop_source& operator=(basic_stop_source&& __other) noexcept {
+    basic_stop_source __tmp{std::move(__other)};
     swap(__tmp);
     return *this;
   }
 
-  stop_source& operator=(const stop_source& __other) noexcept {
+  basic_stop_source& operator=(const basic_stop_source& __other) noexcept {
     if (__state_ != __other.__state_) {
-      stop_source __tmp{__other};
+      basic_stop_source __tmp{__other};
       swap(__tmp);
     }
     return *this;
@@ -456,37 +1123,154 @@ class stop_source {
     return false;
   }
 
-  [[nodiscard]] stop_token get_token() const noexcept {
-    return stop_token{__state_};
+  [[nodiscard]] basic_stop_token<_Policy> get_token() const noexcept {
+    return basic_stop_token<_Policy>{__state_};
   }
 
-  void swap(stop_source& __other) noexcept {
+  void swap(basic_stop_source& __other) noexcept {
     std::swap(__state_, __other.__state_);
   }
 
   [[nodiscard]] friend bool operator==(
-      const stop_source& __a,
-      const stop_source& __b) noexcept {
+      const basic_stop_source& __a,
+      const basic_stop_source& __b) noexcept {
     return __a.__state_ == __b.__state_;
   }
   [[nodiscard]] friend bool operator!=(
-      const stop_source& __a,
-      const stop_source& __b) noexcept {
+      const basic_stop_source& __a,
+      const basic_stop_source& __b) noexcept {
     return __a.__state_ != __b.__state_;
   }
 
  private:
-  __stop_state* __state_;
+  friend struct __stop_source_access;
+
+  __basic_stop_state<_Policy>* __state_;
 };
 
 
 //-----------------------------------------------
-// stop_callback
+// request_stop_all()
+// - request stop on a batch of sources (e.g. all requests of a client):
+//   - first sets the 'stop_requested' signal of all of them,
+//     then executes the registered callbacks
+//   - with __workers > 1, the callbacks of different sources are
+//     executed by up to __workers threads (including the calling thread)
+// - return: number of sources for which this call requested stop
+// - not cheaper than calling request_stop() on each source (every state
+//   is visited twice); use it for the ordering (callbacks see all
+//   sources stopped) or to spread expensive callbacks over threads
 //-----------------------------------------------
 
-template <typename _Callback>
+struct __stop_source_access {
+  template <typename _Policy>
+  static __basic_stop_state<_Policy>* __state(
+      const basic_stop_source<_Policy>& __source) noexcept {
+    return __source.__state_;
+  }
+
+  // take over the source reference of __source (see __adopt())
+  template <typename _Policy>
+  static __basic_stop_state<_Policy>* __release(
+      basic_stop_source<_Policy>& __source) noexcept {
+    return std::exchange(__source.__state_, nullptr);
+  }
+
+  // new source for a state of a released reference (which stays owned)
+  template <typename _Policy>
+  static basic_stop_source<_Policy> __share(
+      __basic_stop_state<_Policy>* __state) noexcept {
+    basic_stop_source<_Policy> __source{nostopstate};
+    __source.__state_ = __state;
+    __state->__add_source_reference();
+    return __source;
+  }
+
+  // whether __source is the only reference to an unstopped state without
+  // callbacks (e.g. to reuse it instead of allocating a new one)
+  template <typename _Policy>
+  static bool __unshared(const basic_stop_source<_Policy>& __source) noexcept {
+    return __source.__state_ != nullptr && __source.__state_->__is_unshared();
+  }
+
+  // give a released reference back to a source
+  template <typename _Policy>
+  static basic_stop_source<_Policy> __adopt(
+      __basic_stop_state<_Policy>* __state) noexcept {
+    basic_stop_source<_Policy> __source{nostopstate};
+    __source.__state_ = __state;
+    return __source;
+  }
+};
+
+template <typename _ForwardIt>
+std::size_t request_stop_all(_ForwardIt __first, _ForwardIt __last,
+                             unsigned __workers = 1) {
+  using __state_type = std::remove_pointer_t<decltype(
+      __stop_source_access::__state(*__first))>;
+
+  // phase 1: signal all, collect the states with callbacks
+  // (reserved up front: a signaled state must not miss phase 2)
+  std::size_t __count = 0;
+  std::vector<__state_type*> __pending;
+  __pending.reserve(static_cast<std::size_t>(std::distance(__first, __last)));
+  for (auto __it = __first; __it != __last; ++__it) {
+    auto* __state = __stop_source_access::__state(*__it);
+    bool __hasCallbacks = false;
+    if (__state != nullptr && __state->__signal_stop(__hasCallbacks)) {
+      ++__count;
+      if (__hasCallbacks) {
+        __pending.push_back(__state);
+      }
+    }
+  }
+
+  // phase 2: execute the callbacks
+  auto __execute = [&__pending] (std::size_t __begin, std::size_t __end) {
+    for (std::size_t __i = __begin; __i < __end; ++__i) {
+      __pending[__i]->__execute_callbacks();
+    }
+  };
+  std::size_t __threads = __workers > 1 ? __workers : 1;
+  if (__threads > __pending.size()) {
+    __threads = __pending.size() > 0 ? __pending.size() : 1;
+  }
+  const std::size_t __chunk = (__pending.size() + __threads - 1) / __threads;
+  std::vector<std::thread> __helpers;
+  std::size_t __t = 1;
+  try {
+    for (; __t < __threads; ++__t) {
+      __helpers.emplace_back(__execute, __t * __chunk,
+                             std::min(__pending.size(), (__t + 1) * __chunk));
+    }
+  }
+  catch (...) {
+    // can't start more threads: execute their chunks ourselves
+  }
+  __execute(0, std::min(__pending.size(), __chunk));
+  __execute(__t * __chunk, __pending.size());
+  for (auto& __helper : __helpers) {
+    __helper.join();
+  }
+  return __count;
+}
+
+template <typename _Range>
+std::size_t request_stop_all(_Range& __sources, unsigned __workers = 1) {
+  return request_stop_all(std::begin(__sources), std::end(__sources), __workers);
+}
+
+
+//-----------------------------------------------
+// basic_stop_callback / stop_callback
+//-----------------------------------------------
+
+template <typename _Callback, typename _Policy>
 // requires Destructible<_Callback> && Invocable<_Callback>
-class [[nodiscard]] stop_callback : private __stop_callback_base {
+class [[nodiscard]] basic_stop_callback
+  : private __basic_stop_callback_base<_Policy> {
+  using __stop_callback_base = __basic_stop_callback_base<_Policy>;
+
  public:
   using callback_type = _Callback;
 
@@ -494,10 +1278,10 @@ class [[nodiscard]] stop_callback : private __stop_callback_base {
     typename _CB,
     std::enable_if_t<std::is_constructible_v<_Callback, _CB>, int> = 0>
     // requires Constructible<Callback, C>
-  explicit stop_callback(const stop_token& __token, _CB&& __cb) noexcept(
+  explicit basic_stop_callback(const basic_stop_token<_Policy>& __token, _CB&& __cb) noexcept(
       std::is_nothrow_constructible_v<_Callback, _CB>)
       : __stop_callback_base{[](__stop_callback_base *__that) noexcept {
-          static_cast<stop_callback*>(__that)->__execute();
+          static_cast<basic_stop_callback*>(__that)->__execute();
         }},
         __state_(nullptr),
         __cb_(static_cast<_CB&&>(__cb)) {
@@ -511,10 +1295,10 @@ class [[nodiscard]] stop_callback : private __stop_callback_base {
     typename _CB,
     std::enable_if_t<std::is_constructible_v<_Callback, _CB>, int> = 0>
     // requires Constructible<Callback, C>
-  explicit stop_callback(stop_token&& __token, _CB&& __cb) noexcept(
+  explicit basic_stop_callback(basic_stop_token<_Policy>&& __token, _CB&& __cb) noexcept(
       std::is_nothrow_constructible_v<_Callback, _CB>)
       : __stop_callback_base{[](__stop_callback_base *__that) noexcept {
-          static_cast<stop_callback*>(__that)->__execute();
+          static_cast<basic_stop_callback*>(__that)->__execute();
         }},
         __state_(nullptr),
         __cb_(static_cast<_CB&&>(__cb)) {
@@ -524,7 +1308,7 @@ class [[nodiscard]] stop_callback : private __stop_callback_base {
     }
   }
 
-  ~stop_callback() {
+  ~basic_stop_callback() {
 #ifdef SAFE
     if (__inExecute_.load()) {
       std::cerr << "*** OOPS: ~stop_callback() while callback executed\n";
@@ -535,10 +1319,10 @@ class [[nodiscard]] stop_callback : private __stop_callback_base {
     }
   }
 
-  stop_callback& operator=(const stop_callback&) = delete;
-  stop_callback& operator=(stop_callback&&) = delete;
-  stop_callback(const stop_callback&) = delete;
-  stop_callback(stop_callback&&) = delete;
+  basic_stop_callback& operator=(const basic_stop_callback&) = delete;
+  basic_stop_callback& operator=(basic_stop_callback&&) = delete;
+  basic_stop_callback(const basic_stop_callback&) = delete;
+  basic_stop_callback(basic_stop_callback&&) = delete;
 
  private:
   void __execute() noexcept {
@@ -553,14 +1337,283 @@ class [[nodiscard]] stop_callback : private __stop_callback_base {
 #endif
   }
 
-  __stop_state* __state_;
+  __basic_stop_state<_Policy>* __state_;
   _Callback __cb_;
 #ifdef SAFE
   std::atomic<bool> __inExecute_{false};
 #endif
 };
 
+template <typename _Callback>
+// requires Destructible<_Callback> && Invocable<_Callback>
+class [[nodiscard]] stop_callback
+  : public basic_stop_callback<_Callback, default_stop_policy> {
+ public:
+  using basic_stop_callback<_Callback, default_stop_policy>::basic_stop_callback;
+};
+
+template<typename _Callback, typename _Policy>
+  basic_stop_callback(basic_stop_token<_Policy>, _Callback)
+    -> basic_stop_callback<_Callback, _Policy>;
+
 template<typename _Callback>
   stop_callback(stop_token, _Callback) -> stop_callback<_Callback>;
 
+
+//-----------------------------------------------
+// unsynchronized_stop_source / unsynchronized_stop_token
+// unsynchronized_stop_callback
+// - same API for single-threaded use (see unsynchronized_stop_policy)
+//-----------------------------------------------
+
+using unsynchronized_stop_token = basic_stop_token<unsynchronized_stop_policy>;
+using unsynchronized_stop_source = basic_stop_source<unsynchronized_stop_policy>;
+
+template <typename _Callback>
+// requires Destructible<_Callback> && Invocable<_Callback>
+class [[nodiscard]] unsynchronized_stop_callback
+  : public basic_stop_callback<_Callback, unsynchronized_stop_policy> {
+ public:
+  using basic_stop_callback<_Callback, unsynchronized_stop_policy>::basic_stop_callback;
+};
+
+template<typename _Callback>
+  unsynchronized_stop_callback(unsynchronized_stop_token, _Callback)
+    -> unsynchronized_stop_callback<_Callback>;
+
+template <typename _Callback>
+struct __stop_callback_type<_Callback, unsynchronized_stop_policy> {
+  using type = unsynchronized_stop_callback<_Callback>;
+};
+
+
+//-----------------------------------------------
+// relocatable_stop_callback
+// - stop callback that can be moved (e.g. kept in a std::vector)
+// - a move transfers the registration to the new object:
+//   - the old object is unregistered, the callback is moved,
+//     and the new object is registered with the same token reference
+//   - if stop is requested during the move, the callback
+//     is executed by the moving thread
+//   - if the callback has already been executed, the new object is
+//     not registered (a move waits for a concurrent execution to end)
+// - move assignment requires a move assignable callback
+//-----------------------------------------------
+
+template <typename _Callback, typename _Policy = default_stop_policy>
+// requires Destructible<_Callback> && Invocable<_Callback>
+//       && MoveConstructible<_Callback>
+class [[nodiscard]] relocatable_stop_callback
+  : private __basic_stop_callback_base<_Policy> {
+  using __stop_callback_base = __basic_stop_callback_base<_Policy>;
+
+ public:
+  using callback_type = _Callback;
+
+  template <
+    typename _CB,
+    std::enable_if_t<std::is_constructible_v<_Callback, _CB>, int> = 0>
+    // requires Constructible<Callback, C>
+  explicit relocatable_stop_callback(const basic_stop_token<_Policy>& __token, _CB&& __cb) noexcept(
+      std::is_nothrow_constructible_v<_Callback, _CB>)
+      : __stop_callback_base{&__execute_callback},
+        __state_(nullptr),
+        __cb_(static_cast<_CB&&>(__cb)) {
+    if (__token.__state_ != nullptr &&
+        __token.__state_->__try_add_callback(this, true)) {
+      __state_ = __token.__state_;
+    }
+  }
+
+  template <
+    typename _CB,
+    std::enable_if_t<std::is_constructible_v<_Callback, _CB>, int> = 0>
+    // requires Constructible<Callback, C>
+  explicit relocatable_stop_callback(basic_stop_token<_Policy>&& __token, _CB&& __cb) noexcept(
+      std::is_nothrow_constructible_v<_Callback, _CB>)
+      : __stop_callback_base{&__execute_callback},
+        __state_(nullptr),
+        __cb_(static_cast<_CB&&>(__cb)) {
+    if (__token.__state_ != nullptr &&
+        __token.__state_->__try_add_callback(this, false)) {
+      __state_ = std::exchange(__token.__state_, nullptr);
+    }
+  }
+
+  // (if moving the callback throws, __other is registered again)
+  relocatable_stop_callback(relocatable_stop_callback&& __other) noexcept(
+      std::is_nothrow_move_constructible_v<_Callback>)
+  try : __stop_callback_base{&__execute_callback},
+        __state_(__other.__detach()),
+        __cb_(std::move(__other.__cb_)) {
+    __other.__state_ = nullptr;
+    __reattach();
+  }
+  catch (...) {
+    __other.__reattach();
+  }
+
+  relocatable_stop_callback& operator=(relocatable_stop_callback&& __other) noexcept(
+      std::is_nothrow_move_assignable_v<_Callback>) {
+    if (this != &__other) {
+      if (__state_ != nullptr) {
+        std::exchange(__state_, nullptr)->__remove_callback(this);
+      }
+      __other.__detach();
+      if constexpr (std::is_nothrow_move_assignable_v<_Callback>) {
+        __cb_ = std::move(__other.__cb_);
+      }
+      else {
+        try {
+          __cb_ = std::move(__other.__cb_);
+        }
+        catch (...) {
+          __other.__reattach();
+          throw;
+        }
+      }
+      __state_ = std::exchange(__other.__state_, nullptr);
+      __reattach();
+    }
+    return *this;
+  }
+
+  ~relocatable_stop_callback() {
+    if (__state_ != nullptr) {
+      __state_->__remove_callback(this);
+    }
+  }
+
+  relocatable_stop_callback& operator=(const relocatable_stop_callback&) = delete;
+  relocatable_stop_callback(const relocatable_stop_callback&) = delete;
+
+ private:
+  static void __execute_callback(__stop_callback_base* __that) noexcept {
+    // Executed in a noexcept context
+    // If it throws then we call std::terminate().
+    static_cast<relocatable_stop_callback*>(__that)->__cb_();
+  }
+
+  // unregister for a move, return the state whose reference is moved
+  // (__state_ keeps it until the callback was moved, see the move
+  // operations; nullptr if the callback was already executed)
+  __basic_stop_state<_Policy>* __detach() noexcept {
+    if (__state_ != nullptr && !__state_->__try_detach_callback(this)) {
+      __state_ = nullptr;
+    }
+    return __state_;
+  }
+
+  // register after a move (reusing the token reference of the source)
+  void __reattach() noexcept {
+    // (this may have been registered and executed before a move assignment)
+    this->__isRemoved_ = nullptr;
+    this->__callbackFinishedExecuting_.store(false, std::memory_order_relaxed);
+    if (__state_ != nullptr && !__state_->__try_add_callback(this, false)) {
+      // executed inline (stop requested meanwhile) or no longer stoppable
+      std::exchange(__state_, nullptr)->__remove_token_reference();
+    }
+  }
+
+  __basic_stop_state<_Policy>* __state_;
+  _Callback __cb_;
+};
+
+template<typename _Callback, typename _Policy>
+  relocatable_stop_callback(basic_stop_token<_Policy>, _Callback)
+    -> relocatable_stop_callback<_Callback, _Policy>;
+
+
+//-----------------------------------------------
+// never_stop_token
+// - token for callers that have nothing to cancel
+// - stop_possible() is a constant expression, so generic code
+//   can compile the cancellation path away entirely
+//-----------------------------------------------
+
+class never_stop_token {
+  // no-op callback: never registered, never invoked
+  class __callback_type {
+   public:
+    template <typename _CB>
+    explicit __callback_type(never_stop_token, _CB&&) noexcept {}
+
+    __callback_type& operator=(const __callback_type&) = delete;
+    __callback_type& operator=(__callback_type&&) = delete;
+    __callback_type(const __callback_type&) = delete;
+    __callback_type(__callback_type&&) = delete;
+  };
+
+ public:
+  template <typename _Callback>
+  using callback_type = __callback_type;
+
+  [[nodiscard]] static constexpr bool stop_requested() noexcept {
+    return false;
+  }
+
+  [[nodiscard]] static constexpr bool stop_possible() noexcept {
+    return false;
+  }
+
+  [[nodiscard]] friend constexpr bool operator==(
+      const never_stop_token&,
+      const never_stop_token&) noexcept {
+    return true;
+  }
+  [[nodiscard]] friend constexpr bool operator!=(
+      const never_stop_token&,
+      const never_stop_token&) noexcept {
+    return false;
+  }
+};
+
+
+//-----------------------------------------------
+// stoppable_token / unstoppable_token
+// - C++17 emulation of the concepts as constexpr bool variable templates
+//-----------------------------------------------
+
+// callback type associated with token type _Token:
+template <typename _Token, typename _Callback>
+using stop_callback_for_t =
+    typename _Token::template callback_type<_Callback>;
+
+struct __stop_callback_archetype {
+  void operator()() noexcept {}
+};
+
+template <typename _Token, typename = void>
+struct __is_stoppable_token : std::false_type {};
+
+template <typename _Token>
+struct __is_stoppable_token<_Token, std::void_t<
+    stop_callback_for_t<_Token, __stop_callback_archetype>,
+    decltype(bool(std::declval<const _Token&>().stop_requested())),
+    decltype(bool(std::declval<const _Token&>().stop_possible())),
+    decltype(bool(std::declval<const _Token&>() == std::declval<const _Token&>())),
+    decltype(bool(std::declval<const _Token&>() != std::declval<const _Token&>()))>>
+  : std::bool_constant<
+      std::is_nothrow_copy_constructible_v<_Token> &&
+      std::is_nothrow_move_constructible_v<_Token> &&
+      std::is_constructible_v<
+          stop_callback_for_t<_Token, __stop_callback_archetype>,
+          const _Token&, __stop_callback_archetype>> {};
+
+// requires stoppable_token<_Token> && (_Token::stop_possible() is constexpr false)
+template <typename _Token, typename = void>
+struct __is_unstoppable_token : std::false_type {};
+
+template <typename _Token>
+struct __is_unstoppable_token<_Token, std::void_t<
+    std::bool_constant<_Token::stop_possible()>>>
+  : std::bool_constant<__is_stoppable_token<_Token>::value &&
+                       !_Token::stop_possible()> {};
+
+template <typename _Token>
+inline constexpr bool stoppable_token = __is_stoppable_token<_Token>::value;
+
+template <typename _Token>
+inline constexpr bool unstoppable_token = __is_unstoppable_token<_Token>::value;
+
 } // namespace std
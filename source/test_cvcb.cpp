@@ -48,7 +48,41 @@ void testCVCallback()
   assert(cbCalled);
   std::cout << "\n*** OK" << std::endl;
 }
-  
+
+
+//------------------------------------------------------
+
+void testCVNeverStopToken()
+{
+  std::cout << "*** start testCVNeverStopToken()" << std::endl;
+
+  bool ready{false};
+  std::mutex readyMutex;
+  std::condition_variable_any2 readyCV;
+  std::never_stop_token ntoken;
+
+  {
+    // timed wait without notification simply times out:
+    std::unique_lock<std::mutex> lg{readyMutex};
+    bool ret = readyCV.wait_for(lg, ntoken, 100ms, [&ready] { return ready; });
+    assert(!ret);
+  }
+
+  {
+    std::jthread t1{[&] {
+                      std::this_thread::sleep_for(100ms);
+                      std::lock_guard<std::mutex> lg{readyMutex};
+                      ready = true;
+                      readyCV.notify_one();
+                    }};
+    std::unique_lock<std::mutex> lg{readyMutex};
+    bool ret = readyCV.wait(lg, ntoken, [&ready] { return ready; });
+    assert(ret);
+    assert(ready);
+  }
+  std::cout << "\n*** OK" << std::endl;
+}
+
 
 //------------------------------------------------------
 
@@ -66,6 +100,8 @@ int main()
   std::cout << "\n\n**************************\n";
   testCVCallback();
   std::cout << "\n\n**************************\n";
+  testCVNeverStopToken();
+  std::cout << "\n\n**************************\n";
  }
  catch (const std::exception& e) {
    std::cerr << "EXCEPTION: " << e.what() << std::endl;
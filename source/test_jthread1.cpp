@@ -449,6 +449,61 @@ void testJThreadAPI()
 //------------------------------------------------------
 //------------------------------------------------------
 
+void testLazyStopState()
+{
+  // the stop state of a jthread whose callable doesn't take a stop_token
+  // is only created on demand
+  std::cout << "*** start testLazyStopState()" << std::endl;
+  {
+    std::jthread t0;
+    assert(!t0.get_stop_source().stop_possible());
+    assert(!t0.request_stop());
+  }
+  {
+    // stop requested before first use:
+    std::jthread t1{[] {}};
+    assert(t1.request_stop());
+    assert(!t1.request_stop());
+    assert(t1.get_stop_token().stop_requested());
+    assert(t1.get_stop_source() == t1.get_stop_source());
+    t1.join();
+  }
+  {
+    // created on first use (also concurrently):
+    std::jthread t2{[] { std::this_thread::sleep_for(10ms); }};
+    std::stop_source sources[4]{std::stop_source{std::nostopstate},
+                                std::stop_source{std::nostopstate},
+                                std::stop_source{std::nostopstate},
+                                std::stop_source{std::nostopstate}};
+    {
+      std::jthread getters[4];
+      for (int i = 0; i < 4; ++i) {
+        getters[i] = std::jthread{[&, i] { sources[i] = t2.get_stop_source(); }};
+      }
+    }
+    for (auto& s : sources) {
+      assert(s == sources[0]);
+      assert(s.stop_possible() && !s.stop_requested());
+    }
+    std::stop_callback cb{sources[0].get_token(), [] {}};
+    auto stoken = t2.get_stop_token();
+    t2 = std::jthread{};   // signals stop and joins
+    assert(stoken.stop_requested());
+  }
+  {
+    // callable taking a stop_token: created at once
+    std::jthread t3{[] (std::stop_token st) {
+                      while (!st.stop_requested()) {
+                        std::this_thread::sleep_for(1ms);
+                      }
+                    }};
+    assert(t3.get_stop_token().stop_possible());
+  }
+  std::cout << "\n*** OK" << std::endl;
+}
+
+//------------------------------------------------------
+
 int main()
 {
   std::set_terminate([](){
@@ -473,5 +528,7 @@ int main()
   std::cout << "\n\n**************************\n";
   testJThreadAPI();
   std::cout << "\n\n**************************\n";
+  testLazyStopState();
+  std::cout << "\n\n**************************\n";
 }
 
@@ -0,0 +1,209 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "jthread_group.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+TEST(GroupSpawnNRunsEachIndexOnce)
+{
+  constexpr std::size_t n = 100;
+  std::vector<std::atomic<int>> calls(n);
+  std::atomic<int> withToken{0};
+  {
+    std::jthread_group group;
+    group.emplace_back([] {});
+    auto time = group.spawn_n(n, [&] (std::stop_token st, std::size_t i) {
+                  ++calls[i];
+                  if (st.stop_possible()) {
+                    ++withToken;
+                  }
+                });
+    CHECK(time.count() > 0);
+    CHECK(group.size() == n + 1);
+    std::set<std::thread::id> ids;
+    for (auto& t : group) {
+      CHECK(t.joinable());
+      ids.insert(t.get_id());
+    }
+    CHECK(ids.size() == n + 1);
+  }
+  CHECK(std::all_of(calls.begin(), calls.end(), [](auto& c) { return c == 1; }));
+  CHECK(withToken == n);
+
+  // callables taking just the index or nothing
+  std::atomic<std::size_t> sum{0};
+  std::atomic<int> count{0};
+  {
+    std::jthread_group group;
+    group.spawn_n(10, [&sum] (std::size_t i) { sum += i; });
+    group.spawn_n(5, [&count] { ++count; });
+    CHECK(group.size() == 15);
+    CHECK(group.spawn_n(0, [] {}).count() == 0);
+  }
+  CHECK(sum == 45);
+  CHECK(count == 5);
+}
+
+
+//----------------------------------------------------
+
+TEST(GroupSpawnNWaitsForAllStarted)
+{
+  using clock = std::chrono::steady_clock;
+  constexpr std::size_t n = 64;
+  std::vector<clock::time_point> entered(n);
+  std::atomic<std::size_t> running{0};
+  std::jthread_group group;
+  auto before = clock::now();
+  auto time = group.spawn_n(n, [&] (std::stop_token st, std::size_t i) {
+                entered[i] = clock::now();
+                ++running;
+                while (!st.stop_requested()) {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                }
+              },
+              true);
+  while (running < n) {
+    std::this_thread::yield();
+  }
+  group.request_stop();
+  // with the barrier, no thread ran f before all had started:
+  for (auto& t : entered) {
+    CHECK(t >= before + time);
+  }
+}
+
+
+//----------------------------------------------------
+
+TEST(GroupStopAndJoin)
+{
+  std::atomic<int> stopped{0};
+  auto untilStopped = [&stopped] (std::stop_token st) {
+    while (!st.stop_requested()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    ++stopped;
+  };
+  std::jthread_group group;
+  group.spawn_n(8, untilStopped);
+  group.emplace_back(untilStopped);
+  group.stop_and_join();
+  CHECK(stopped == 9);
+  CHECK(group.empty());
+
+  // the destructor and move assignment stop and join, too
+  {
+    std::jthread_group other;
+    other.spawn_n(4, untilStopped);
+    group.spawn_n(2, untilStopped);
+    group = std::move(other);
+    CHECK(stopped == 11);
+    CHECK(group.size() == 4);
+  }
+  group = std::jthread_group{};
+  CHECK(stopped == 15);
+}
+
+
+//----------------------------------------------------
+
+// benchmark: shutdown of threads that take 20ms to exit after a stop
+// request, vector<jthread> (one after another) vs. jthread_group
+TEST(GroupShutdownLatency)
+{
+  constexpr std::size_t n = 16;
+  auto slowExit = [] (std::stop_token st, auto...) {
+    while (!st.stop_requested()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  };
+  auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  std::chrono::steady_clock::time_point start;
+  {
+    std::vector<std::jthread> threads;
+    for (std::size_t i = 0; i < n; ++i) {
+      threads.emplace_back(slowExit);
+    }
+    start = std::chrono::steady_clock::now();
+  }
+  auto sequential = std::chrono::steady_clock::now() - start;
+  {
+    std::jthread_group group;
+    group.spawn_n(n, slowExit);
+    start = std::chrono::steady_clock::now();
+  }
+  auto parallel = std::chrono::steady_clock::now() - start;
+  std::cout << "shutdown of " << n << " threads: vector<jthread> " << ms(sequential)
+            << "ms, jthread_group " << ms(parallel) << "ms" << std::endl;
+  CHECK(parallel < sequential);
+}
+
+
+//----------------------------------------------------
+
+// benchmark: time until n threads are up, one after another vs. spawn_n()
+TEST(GroupSpawnNStartupTime)
+{
+  constexpr std::size_t n = 256;
+  auto work = [] (std::stop_token st, auto...) {
+    while (!st.stop_requested()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  };
+  using duration_t = std::chrono::steady_clock::duration;
+  duration_t sequential = duration_t::max(), tree = duration_t::max();
+  for (int run = 0; run < 3; ++run) {
+    {
+      std::atomic<std::size_t> started{0};
+      std::vector<std::jthread> threads;
+      threads.reserve(n);
+      auto start = std::chrono::steady_clock::now();
+      for (std::size_t i = 0; i < n; ++i) {
+        threads.emplace_back([&started, work] (std::stop_token st) {
+                               ++started;
+                               work(st);
+                             });
+      }
+      while (started < n) {
+        std::this_thread::yield();
+      }
+      sequential = std::min(sequential, std::chrono::steady_clock::now() - start);
+      for (auto& t : threads) {
+        t.request_stop();
+      }
+    }
+    {
+      std::jthread_group group;
+      auto time = group.spawn_n(n, work);
+      tree = std::min<duration_t>(tree, time);
+      group.request_stop();
+    }
+  }
+  auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+  std::cout << n << " threads up: one by one " << ms(sequential)
+            << "ms, spawn_n " << ms(tree) << "ms" << std::endl;
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
@@ -0,0 +1,364 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <ctime>
+#include <vector>
+#include <memory>
+#include <string>
+
+#include "jthread_pool.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+template <typename Pred>
+static void waitUntil(Pred pred)
+{
+  while (!pred()) {
+    std::this_thread::yield();
+  }
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolRunsTasksWithAndWithoutToken)
+{
+  std::atomic<int> plain{0}, withToken{0};
+  std::jthread_pool pool{4};
+  CHECK(pool.size() == 4);
+  for (int i = 0; i < 1000; ++i) {
+    pool.submit([&plain] { ++plain; });
+    pool.submit([&withToken] (std::stop_token st) {
+                  if (st.stop_possible() && !st.stop_requested()) {
+                    ++withToken;
+                  }
+                });
+  }
+  waitUntil([&] { return plain == 1000 && withToken == 1000; });
+
+  // large callables (stored on the heap) and move-only ones
+  std::string big(1000, 'x');
+  std::atomic<std::size_t> length{0};
+  auto p = std::make_unique<int>(42);
+  pool.submit([big, &length, p = std::move(p)] { length = big.size() + *p; });
+  waitUntil([&] { return length == 1042; });
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolTaskWithOwnToken)
+{
+  std::jthread_pool pool{1};
+  std::stop_source taskSource;
+  std::atomic<bool> started{false}, stopSeen{false}, ran{false};
+  pool.submit([&] (std::stop_token st) {
+                started = true;
+                waitUntil([&] { return st.stop_requested(); });
+                stopSeen = true;
+              },
+              taskSource.get_token());
+  waitUntil([&] { return started.load(); });
+  // queued behind the running task; dropped once its token is stopped
+  pool.submit([&ran] { ran = true; }, taskSource.get_token());
+  CHECK(!pool.get_stop_token().stop_requested());
+  taskSource.request_stop();
+  waitUntil([&] { return stopSeen.load(); });
+
+  // already stopped: not queued at all
+  pool.submit([&ran] { ran = true; }, taskSource.get_token());
+  std::atomic<bool> last{false};
+  pool.submit([&last] { last = true; });
+  waitUntil([&] { return last.load(); });
+  CHECK(!ran);
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolStopReachesTaskWithOwnToken)
+{
+  std::stop_source taskSource;
+  std::atomic<bool> started{false}, stopSeen{false};
+  {
+    std::jthread_pool pool{1};
+    pool.submit([&] (std::stop_token st) {
+                  started = true;
+                  waitUntil([&] { return st.stop_requested(); });
+                  stopSeen = true;
+                },
+                taskSource.get_token());
+    waitUntil([&] { return started.load(); });
+  }   // the pool's stop reaches the task (doesn't hang)
+  CHECK(stopSeen);
+  CHECK(!taskSource.stop_requested());
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolLinkedTokensOfSuccessiveTasks)
+{
+  // (the worker reuses the linked stop state only while nobody else
+  // refers to it)
+  std::jthread_pool pool{1};
+  std::stop_source first;
+  std::atomic<bool> started{false};
+  std::stop_token kept;
+  std::atomic<int> done{0};
+  pool.submit([&] (std::stop_token st) {
+                started = true;
+                waitUntil([&] { return st.stop_requested(); });
+                ++done;
+              },
+              first.get_token());
+  waitUntil([&] { return started.load(); });
+  first.request_stop();   // stops the running task
+  waitUntil([&] { return done == 1; });
+
+  std::stop_source second;
+  std::atomic<bool> stoppedAtStart{true};
+  pool.submit([&] (std::stop_token st) {
+                stoppedAtStart = st.stop_requested();
+                kept = st;   // outlives the task
+                ++done;
+              },
+              second.get_token());
+  waitUntil([&] { return done == 2; });
+  CHECK(!stoppedAtStart);
+
+  std::stop_source third;
+  started = false;
+  pool.submit([&] (std::stop_token st) {
+                started = true;
+                waitUntil([&] { return st.stop_requested(); });
+                ++done;
+              },
+              third.get_token());
+  waitUntil([&] { return started.load(); });   // (queued: just dropped)
+  third.request_stop();
+  waitUntil([&] { return done == 3; });
+  CHECK(!kept.stop_requested());   // not the state of the third task
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolUnlinksCancelledTasksImmediately)
+{
+  std::jthread_pool pool{1};
+  std::atomic<bool> started{false}, release{false};
+  pool.submit([&] { started = true; waitUntil([&] { return release.load(); }); });
+  waitUntil([&] { return started.load(); });
+
+  // queued behind the blocked worker:
+  constexpr int count = 100'000;
+  std::stop_source cancel;
+  auto captured = std::make_shared<int>(0);
+  std::atomic<int> ran{0};
+  for (int i = 0; i < count; ++i) {
+    pool.submit([captured, &ran] { ++ran; }, cancel.get_token());
+  }
+  std::atomic<bool> kept{false};
+  pool.submit([&kept] { kept = true; });
+  CHECK(captured.use_count() == count + 1);
+
+  auto start = std::chrono::steady_clock::now();
+  cancel.request_stop();
+  auto end = std::chrono::steady_clock::now();
+  // destroyed by request_stop(), while the worker is still blocked:
+  CHECK(captured.use_count() == 1);
+  std::cout << "cancelling " << count << " queued tasks took "
+            << std::chrono::duration<double, std::milli>(end - start).count()
+            << "ms" << std::endl;
+
+  release = true;
+  waitUntil([&] { return kept.load(); });
+  CHECK(ran == 0);
+
+  // nodes are reused
+  for (int i = 0; i < 100; ++i) {
+    pool.submit([&ran] { ++ran; }, cancel.get_token());   // (not queued)
+    pool.submit([&ran] (std::stop_token) { ++ran; }, std::stop_source{}.get_token());
+  }
+  waitUntil([&] { return ran == 100; });
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolDestructorStopsRunningAndDropsQueued)
+{
+  std::atomic<int> stopped{0}, started{0};
+  auto dropped = std::make_shared<int>(0);
+  {
+    std::jthread_pool pool{2};
+    for (int i = 0; i < 2; ++i) {
+      pool.submit([&] (std::stop_token st) {
+                    ++started;
+                    waitUntil([&] { return st.stop_requested(); });
+                    ++stopped;
+                  });
+    }
+    waitUntil([&] { return started == 2; });
+    for (int i = 0; i < 100; ++i) {
+      pool.submit([dropped] { ++*dropped; });
+    }
+    CHECK(dropped.use_count() == 101);
+  }
+  CHECK(stopped == 2);
+  CHECK(*dropped == 0);
+  CHECK(dropped.use_count() == 1);   // queued tasks destroyed
+}
+
+
+//----------------------------------------------------
+
+TEST(PoolIdleWorkersSleep)
+{
+  std::jthread_pool pool{4};
+  // idle workers block in the kernel: this thread gets the CPU
+  auto cpuStart = std::clock();
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  auto cpuUsed = std::clock() - cpuStart;
+  CHECK(cpuUsed < CLOCKS_PER_SEC / 20);   // < 50ms CPU for 4 x 100ms idle
+}
+
+
+//----------------------------------------------------
+
+TEST(ElasticPoolGrowsAndShrinks)
+{
+  std::elastic_pool_options options;
+  options.min_workers = 1;
+  options.max_workers = 4;
+  options.target_delay = std::chrono::milliseconds(1);
+  options.idle_timeout = std::chrono::milliseconds(50);
+  std::jthread_pool pool{options};
+  CHECK(pool.size() == 1);
+
+  std::atomic<int> done{0};
+  for (int i = 0; i < 40; ++i) {
+    pool.submit([&done] {
+                  std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                  ++done;
+                });
+  }
+  waitUntil([&] { return done == 40; });
+  auto grown = pool.metrics();
+  CHECK(grown.grown > 0);
+  CHECK(grown.peak_workers > 1);
+  CHECK(grown.peak_workers <= 4);
+  CHECK(grown.max_queue_delay > std::chrono::milliseconds(1));
+
+  // idle workers retire down to min_workers
+  waitUntil([&] { return pool.size() == 1; });
+  auto shrunk = pool.metrics();
+  CHECK(shrunk.workers == 1);
+  CHECK(shrunk.retired == shrunk.grown);
+
+  // and still run tasks
+  std::atomic<bool> ran{false};
+  pool.submit([&ran] { ran = true; });
+  waitUntil([&] { return ran.load(); });
+}
+
+
+//----------------------------------------------------
+
+// benchmark: queueing latency under bursty load, fixed vs. elastic pool
+// (tasks block for 1ms as if waiting for I/O)
+template <typename Pool>
+static std::vector<double> measureBursts(Pool& pool)
+{
+  using clock = std::chrono::steady_clock;
+  constexpr int bursts = 10, tasksPerBurst = 40;
+  std::vector<double> latencies(bursts * tasksPerBurst);
+  std::atomic<int> done{0};
+  for (int b = 0; b < bursts; ++b) {
+    for (int i = 0; i < tasksPerBurst; ++i) {
+      auto submitted = clock::now();
+      double* latency = &latencies[b * tasksPerBurst + i];
+      pool.submit([submitted, latency, &done] {
+                    *latency = std::chrono::duration<double, std::milli>(clock::now() - submitted).count();
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    ++done;
+                  });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+  }
+  waitUntil([&] { return done == bursts * tasksPerBurst; });
+  std::sort(latencies.begin(), latencies.end());
+  return latencies;
+}
+
+TEST(ElasticPoolBurstLatency)
+{
+  auto report = [](const char* label, const std::vector<double>& l) {
+    std::cout << label << ": p50 " << l[l.size() / 2] << "ms, p99 "
+              << l[l.size() * 99 / 100] << "ms, max " << l.back() << "ms" << std::endl;
+  };
+  {
+    std::jthread_pool pool{2};
+    report("fixed pool (2 workers)   ", measureBursts(pool));
+  }
+  {
+    std::elastic_pool_options options;
+    options.min_workers = 2;
+    options.max_workers = 32;
+    options.target_delay = std::chrono::milliseconds(1);
+    options.idle_timeout = std::chrono::milliseconds(100);
+    std::jthread_pool pool{options};
+    report("elastic pool (2-32)      ", measureBursts(pool));
+    auto m = pool.metrics();
+    std::cout << "  resizes: grown " << m.grown << ", retired " << m.retired
+              << ", peak " << m.peak_workers << " workers" << std::endl;
+  }
+}
+
+
+//----------------------------------------------------
+
+// benchmark: tasks per second, submitted from one thread
+TEST(PoolThroughput)
+{
+  constexpr int count = 1'000'000;
+  std::vector<unsigned> workerCounts{1, 4};
+  if (std::jthread::hardware_concurrency() > 4) {
+    workerCounts.push_back(std::jthread::hardware_concurrency());
+  }
+  for (unsigned workers : workerCounts) {
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+      std::atomic<int> done{0};
+      std::jthread_pool pool{workers};
+      auto start = std::chrono::steady_clock::now();
+      for (int i = 0; i < count; ++i) {
+        pool.submit([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+      }
+      waitUntil([&] { return done.load(std::memory_order_relaxed) == count; });
+      auto end = std::chrono::steady_clock::now();
+      best = std::max(best, count / std::chrono::duration<double>(end - start).count());
+    }
+    std::cout << "jthread_pool with " << workers << " workers: "
+              << static_cast<long>(best) << " tasks/s" << std::endl;
+  }
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
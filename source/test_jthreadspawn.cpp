@@ -0,0 +1,575 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cerrno>
+
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+
+#include "jthread.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+// counts copies and moves of callables/arguments
+struct Counted {
+  static inline std::atomic<int> copies{0};
+  static inline std::atomic<int> moves{0};
+  Counted() = default;
+  Counted(const Counted&) { ++copies; }
+  Counted(Counted&&) noexcept { ++moves; }
+};
+
+TEST(SpawnMovesCallableAndArgumentsOnce)
+{
+  Counted::copies = 0;
+  Counted::moves = 0;
+  std::atomic<bool> tokenPassed{false};
+  {
+    std::jthread t{[] (std::stop_token st, Counted&&, std::unique_ptr<int> p) {
+                     (void)st; (void)p;
+                   },
+                   Counted{}, std::make_unique<int>(42)};
+    tokenPassed = t.get_stop_token().stop_possible();
+  }
+  CHECK(tokenPassed);
+  CHECK(Counted::copies == 0);
+  CHECK(Counted::moves == 1);   // into the start block only
+}
+
+
+//----------------------------------------------------
+
+TEST(SpawnThreadIdAndToken)
+{
+  std::atomic<std::thread::id> innerId{};
+  std::jthread t{[&] (std::stop_token st) {
+                   innerId = std::this_thread::get_id();
+                   while (!st.stop_requested()) {
+                     std::this_thread::yield();
+                   }
+                 }};
+  CHECK(t.joinable());
+  CHECK(t.get_id() != std::thread::id{});
+  t.request_stop();
+  t.join();
+  CHECK(!t.joinable());
+  CHECK(t.get_id() == std::thread::id{});
+  CHECK(innerId.load() != std::this_thread::get_id());
+  CHECK(t.get_stop_token().stop_requested());
+
+  bool thrown = false;
+  try {
+    t.join();
+  }
+  catch (const std::system_error&) {
+    thrown = true;
+  }
+  CHECK(thrown);
+}
+
+
+//----------------------------------------------------
+
+TEST(SpawnDetachedTokenOutlivesThread)
+{
+  std::stop_token st;
+  std::atomic<bool> done{false};
+  {
+    std::jthread t{[&done] (std::stop_token) { done = true; }};
+    st = t.get_stop_token();
+    t.detach();
+  }
+  while (!done) {
+    std::this_thread::yield();
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CHECK(!st.stop_requested());
+  CHECK(!st.stop_possible());   // no source left
+}
+
+
+//----------------------------------------------------
+
+struct alignas(256) OverAligned {
+  char data[256];
+  void operator()(std::atomic<bool>& aligned) const {
+    aligned = reinterpret_cast<std::uintptr_t>(this) % 256 == 0;
+  }
+};
+
+TEST(SpawnOverAlignedCallable)
+{
+  std::atomic<bool> aligned{false};
+  std::jthread{OverAligned{}, std::ref(aligned)}.join();
+  CHECK(aligned);
+}
+
+
+//----------------------------------------------------
+
+TEST(CachedThreadIsReusedAfterJoin)
+{
+  std::set_jthread_cache_limit(2);
+#ifdef JTHREAD_FUSED_START
+  CHECK(std::jthread_cache_limit() == 2);
+#else
+  CHECK(std::jthread_cache_limit() == 0);   // no cache
+#endif
+  std::thread::id first, second;
+  {
+    std::jthread t{[&first] { first = std::this_thread::get_id(); }};
+    t.join();
+    CHECK(t.get_id() == std::thread::id{});
+  }
+  std::jthread t{[&second] (std::stop_token st) {
+                   second = std::this_thread::get_id();
+                   while (!st.stop_requested()) {
+                     std::this_thread::yield();
+                   }
+                 }};
+  CHECK(t.joinable());
+  t.request_stop();
+  t.join();                       // waits for the callable
+  CHECK(second != std::thread::id{});
+#ifdef JTHREAD_FUSED_START
+  CHECK(first == second);         // same OS thread
+#endif
+  std::set_jthread_cache_limit(0);
+}
+
+
+//----------------------------------------------------
+
+TEST(CachedThreadKeepsThreadLocals)
+{
+  static thread_local int calls = 0;
+  auto count = [] (int& result) { result = ++calls; };
+  int first = 0, second = 0;
+  std::jthread{count, std::ref(first)}.join();
+  std::jthread{count, std::ref(second)}.join();
+  CHECK(first == 1);
+  CHECK(second == 1);             // no cache: a fresh thread
+
+  std::set_jthread_cache_limit(1);
+  std::jthread{count, std::ref(first)}.join();
+  std::jthread{count, std::ref(second)}.join();
+  CHECK(first == 1);
+#ifdef JTHREAD_FUSED_START
+  CHECK(second == 2);             // reused: sees the previous value
+#else
+  CHECK(second == 1);
+#endif
+  std::set_jthread_cache_limit(0);
+}
+
+
+//----------------------------------------------------
+
+TEST(CachedThreadIdsStayUniqueUntilJoined)
+{
+  std::set_jthread_cache_limit(4);
+  std::atomic<int> finished{0};
+  std::jthread t1{[&finished] { ++finished; }};
+  std::jthread t2{[&finished] { ++finished; }};
+  while (finished < 2) {
+    std::this_thread::yield();
+  }
+  // t1 has finished but is not joined: its thread is not reused
+  std::jthread t3{[] {}};
+  CHECK(t1.get_id() != t2.get_id());
+  CHECK(t3.get_id() != t1.get_id());
+  CHECK(t3.get_id() != t2.get_id());
+  t1.join();
+  t2.join();
+  t3.join();
+
+  // detached: reused once the callable has returned
+  std::atomic<bool> done{false};
+  std::stop_token st;
+  {
+    std::jthread d{[&done] (std::stop_token) { done = true; }};
+    st = d.get_stop_token();
+    d.detach();
+  }
+  while (!done) {
+    std::this_thread::yield();
+  }
+  std::jthread{[] {}}.join();
+  CHECK(!st.stop_possible());
+  std::set_jthread_cache_limit(0);  // parked threads exit
+  CHECK(std::jthread_cache_limit() == 0);
+}
+
+
+//----------------------------------------------------
+
+TEST(SpawnWithAttributes)
+{
+  std::jthread_attributes attrs;
+  attrs.cpus = {0};
+  attrs.name = "jthread-test";
+  std::atomic<bool> pinned{false};
+  std::string name;
+  std::jthread t{attrs,
+                 [&] (std::stop_token st, int arg) {
+                   // applied before the callable runs:
+                   ::cpu_set_t set;
+                   CPU_ZERO(&set);
+                   ::pthread_getaffinity_np(::pthread_self(), sizeof(set), &set);
+                   pinned = CPU_COUNT(&set) == 1 && CPU_ISSET(0, &set);
+                   char buf[16] = {};
+                   ::pthread_getname_np(::pthread_self(), buf, sizeof(buf));
+                   name = buf;
+                   CHECK(arg == 42);
+                   CHECK(st.stop_possible());
+                 },
+                 42};
+  t.join();
+  CHECK(pinned);
+  CHECK(name == "jthread-test");
+
+  // without a stop_token and only a name:
+  std::jthread_attributes named;
+  named.name = "worker";
+  std::jthread{named, [&name] {
+                 char buf[16] = {};
+                 ::pthread_getname_np(::pthread_self(), buf, sizeof(buf));
+                 name = buf;
+               }}.join();
+  CHECK(name == "worker");
+}
+
+TEST(SpawnWithInvalidAttributesThrows)
+{
+  auto throwsCode = [](const std::jthread_attributes& attrs) {
+    std::atomic<bool> ran{false};
+    try {
+      std::jthread t{attrs, [&ran] { ran = true; }};
+    }
+    catch (const std::system_error& e) {
+      CHECK(!ran);
+      return e.code().value();
+    }
+    return 0;
+  };
+  std::jthread_attributes longName;
+  longName.name = "a-name-longer-than-15";
+  CHECK(throwsCode(longName) == ERANGE);
+
+  std::jthread_attributes badCpu;
+  badCpu.cpus = {CPU_SETSIZE};
+  CHECK(throwsCode(badCpu) == EINVAL);
+
+  std::jthread_attributes badPolicy;
+  badPolicy.sched_policy = 12345;
+  CHECK(throwsCode(badPolicy) == EINVAL);
+}
+
+
+//----------------------------------------------------
+
+// touch about `bytes` of stack
+__attribute__((noinline)) static int useStack(std::size_t bytes)
+{
+  volatile char buf[1024];
+  buf[0] = 1;
+  buf[sizeof(buf) - 1] = 1;
+  return bytes > sizeof(buf) ? useStack(bytes - sizeof(buf)) + buf[0] : buf[0];
+}
+
+static std::atomic<std::size_t> reportedUsed{0}, reportedSize{0};
+
+#ifdef JTHREAD_FUSED_START
+TEST(SpawnSmallStackWithHighWaterMark)
+{
+  std::set_jthread_stack_report([] (std::thread::id, std::size_t used, std::size_t size) {
+    reportedUsed = used;
+    reportedSize = size;
+  });
+  std::jthread_attributes attrs;
+  attrs.stack_size = 64 * 1024;
+  attrs.measure_stack = true;
+  std::jthread t{attrs, [] { useStack(16 * 1024); }};
+  CHECK(t.stack_high_water_mark() == 0);   // not joined yet
+  t.join();
+  std::size_t used = t.stack_high_water_mark();
+  std::cout << "stack high-water mark: " << used << " of "
+            << reportedSize << " bytes" << std::endl;
+  CHECK(used >= 16 * 1024);
+  CHECK(used < reportedSize);
+  CHECK(reportedUsed == used);
+  CHECK(reportedSize >= 48 * 1024);   // (sanitizers may enlarge stacks)
+  std::set_jthread_stack_report(nullptr);
+
+  // not measured:
+  std::jthread_attributes unmeasured;
+  unmeasured.stack_size = 64 * 1024;
+  std::jthread small{unmeasured, [] {}};
+  small.join();
+  CHECK(small.stack_high_water_mark() == 0);
+
+  // many small-stack threads
+  std::vector<std::jthread> threads;
+  std::jthread_attributes tiny;
+  tiny.stack_size = 32 * 1024;
+  std::atomic<bool> release{false};
+  for (int i = 0; i < 200; ++i) {
+    threads.emplace_back(tiny, [&release] (std::stop_token) {
+                           while (!release) {
+                             std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                           }
+                         });
+  }
+  release = true;
+}
+
+TEST(SpawnOnCallerProvidedStack)
+{
+  constexpr std::size_t size = 1024 * 1024;   // (enough for sanitizers)
+  constexpr std::size_t guard = 4096;
+  void* mem = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  CHECK(mem != MAP_FAILED);
+  std::jthread_attributes attrs;
+  attrs.stack = mem;
+  attrs.stack_size = size;
+  attrs.guard_size = guard;
+  attrs.measure_stack = true;
+  std::atomic<bool> onStack{false};
+  std::jthread t{attrs, [&onStack, mem] {
+                   char local;
+                   onStack = &local > static_cast<char*>(mem) + guard &&
+                             &local < static_cast<char*>(mem) + size;
+                   useStack(32 * 1024);
+                 }};
+  t.join();
+  CHECK(onStack);
+  CHECK(t.stack_high_water_mark() >= 32 * 1024);
+  CHECK(t.stack_high_water_mark() < size - guard);
+  static_cast<char*>(mem)[0] = 1;   // guard is writable again
+  ::munmap(mem, size);
+
+  // unaligned stack with guard
+  std::vector<char> buf(size + 1);
+  attrs.stack = buf.data() + 1;
+  bool thrown = false;
+  try {
+    std::jthread bad{attrs, [] {}};
+  }
+  catch (const std::system_error& e) {
+    thrown = e.code().value() == EINVAL;
+  }
+  CHECK(thrown);
+}
+#else
+TEST(SpawnStackAttributesNeedFusedStart)
+{
+  std::jthread_attributes attrs;
+  attrs.stack_size = 64 * 1024;
+  bool thrown = false;
+  try {
+    std::jthread t{attrs, [] {}};
+  }
+  catch (const std::system_error& e) {
+    thrown = e.code().value() == ENOTSUP;
+  }
+  CHECK(thrown);
+}
+#endif
+
+
+//----------------------------------------------------
+
+TEST(TimedAndCancellableJoin)
+{
+  using namespace std::chrono_literals;
+  auto untilStopped = [] (std::stop_token st) {
+    while (!st.stop_requested()) {
+      std::this_thread::sleep_for(1ms);
+    }
+  };
+  for (std::size_t cacheLimit : {0, 1}) {
+    std::set_jthread_cache_limit(cacheLimit);
+    std::jthread t{untilStopped};
+    auto start = std::chrono::steady_clock::now();
+    CHECK(!t.join_for(20ms));
+    CHECK(std::chrono::steady_clock::now() - start >= 20ms);
+    CHECK(!t.join_until(std::chrono::system_clock::now() + 10ms));
+    CHECK(!t.join_until(std::chrono::steady_clock::now() - 1s));
+    CHECK(t.joinable());
+
+    // join(stop_token) gives up once stop is requested
+    std::stop_source cancel;
+    std::jthread canceller{[&cancel] {
+                             std::this_thread::sleep_for(10ms);
+                             cancel.request_stop();
+                           }};
+    CHECK(!t.join(cancel.get_token()));
+    CHECK(!t.join(cancel.get_token()));     // (already stopped)
+    CHECK(t.joinable());
+
+    t.request_stop();
+    CHECK(t.join_for(10s));
+    CHECK(!t.joinable());
+
+    std::jthread done{[] {}};
+    CHECK(done.join(std::stop_token{}));
+    bool thrown = false;
+    try {
+      done.join_for(1ms);
+    }
+    catch (const std::system_error& e) {
+      thrown = e.code().value() == EINVAL;
+    }
+    CHECK(thrown);
+  }
+  std::set_jthread_cache_limit(0);
+}
+
+
+//----------------------------------------------------
+
+TEST(WaitAnyReturnsFirstFinished)
+{
+  std::atomic<int> release{-1};
+  std::vector<std::jthread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&release, i] (std::stop_token st) {
+                           while (release != i && !st.stop_requested()) {
+                             std::this_thread::yield();
+                           }
+                         });
+  }
+  release = 2;
+  auto first = std::wait_any(threads.begin(), threads.end());
+  CHECK(first == threads.begin() + 2);
+  first->join();
+  release = 0;
+  first = std::wait_any(threads.begin(), threads.end());
+  CHECK(first == threads.begin());
+  first->join();
+
+  for (auto& t : threads) {
+    t.request_stop();
+  }
+  for (std::size_t n = 2; n > 0; --n) {
+    first = std::wait_any(threads.begin(), threads.end());
+    CHECK(first != threads.end());
+    first->join();
+  }
+  // none joinable:
+  CHECK(std::wait_any(threads.begin(), threads.end()) == threads.end());
+}
+
+
+//----------------------------------------------------
+
+// benchmark: dropping a thread that takes 50ms to exit after a stop request
+TEST(ReleaseToReaperDoesNotBlock)
+{
+  using namespace std::chrono_literals;
+  std::atomic<int> exited{0};
+  auto slowExit = [&exited] (std::stop_token st) {
+    while (!st.stop_requested()) {
+      std::this_thread::sleep_for(1ms);
+    }
+    std::this_thread::sleep_for(50ms);
+    ++exited;
+  };
+  auto ms = [](auto d) { return std::chrono::duration<double, std::milli>(d).count(); };
+
+  std::chrono::steady_clock::time_point start;
+  {
+    std::jthread t{slowExit};
+    start = std::chrono::steady_clock::now();
+  }
+  auto destructor = std::chrono::steady_clock::now() - start;
+  CHECK(exited == 1);
+
+  std::jthread t{slowExit};
+  auto token = t.get_stop_token();
+  start = std::chrono::steady_clock::now();
+  t.release_to_reaper();
+  auto released = std::chrono::steady_clock::now() - start;
+  CHECK(!t.joinable());
+  CHECK(token.stop_requested());
+  CHECK(released < 50ms);
+  t.release_to_reaper();          // (no thread: no-op)
+  while (exited < 2) {
+    std::this_thread::sleep_for(1ms);
+  }
+  std::cout << "dropping a jthread: destructor " << ms(destructor)
+            << "ms, release_to_reaper() " << ms(released) << "ms" << std::endl;
+
+  // still running at exit: joined by the reaper's destructor
+  std::jthread{[] (std::stop_token st) {
+                 while (!st.stop_requested()) {
+                   std::this_thread::sleep_for(1ms);
+                 }
+                 std::this_thread::sleep_for(50ms);
+               }}.release_to_reaper();
+}
+
+
+//----------------------------------------------------
+
+// benchmark: spawn+join throughput
+template <typename Thread>
+static auto measureSpawnJoin(int count)
+{
+  int sum = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < count; ++i) {
+    Thread t{[&sum, i] { sum += i; }};
+    t.join();
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  assert(sum == count * (count - 1) / 2);
+  return end - start;
+}
+
+TEST(SpawnJoinPerformance)
+{
+  constexpr int count = 10'000;
+
+  auto report = [](const char* label, auto time)
+  {
+    auto ms = std::chrono::duration<double, std::milli>(time).count();
+    auto us = std::chrono::duration<double, std::micro>(time).count();
+    std::cout << label << " took " << ms << "ms (" << (us / count) << " us/thread)" << std::endl;
+  };
+
+  using duration_t = std::chrono::high_resolution_clock::duration;
+  duration_t thread = duration_t::max(), jthread = thread, cached = thread;
+  for (int run = 0; run < 3; ++run) {
+    thread = std::min(thread, measureSpawnJoin<std::thread>(count));
+    jthread = std::min(jthread, measureSpawnJoin<std::jthread>(count));
+    std::set_jthread_cache_limit(1);
+    cached = std::min(cached, measureSpawnJoin<std::jthread>(count));
+    std::set_jthread_cache_limit(0);
+  }
+  report("std::thread         ", thread);
+  report("std::jthread        ", jthread);
+  report("std::jthread (cache)", cached);
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
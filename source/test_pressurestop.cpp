@@ -0,0 +1,149 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <string>
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "pressure_stop_source.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+template <typename Pred>
+static bool waitFor(Pred pred)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+// fake procfs and cgroup directory
+struct FakeRoot {
+  std::string dir;
+
+  FakeRoot() {
+    char tmpl[] = "/tmp/jthread_pressureXXXXXX";
+    dir = ::mkdtemp(tmpl);
+    ::mkdir((dir + "/self").c_str(), 0700);
+    setRssPages(10);
+    setCgroupBytes(1000);
+  }
+  ~FakeRoot() {
+    ::unlink((dir + "/self/statm").c_str());
+    ::unlink((dir + "/memory.current").c_str());
+    ::rmdir((dir + "/self").c_str());
+    ::rmdir(dir.c_str());
+  }
+
+  void setRssPages(long pages) {
+    std::ofstream{dir + "/self/statm"} << (pages * 2) << ' ' << pages << " 0 0 0 0 0\n";
+  }
+  void setCgroupBytes(long bytes) {
+    std::ofstream{dir + "/memory.current"} << bytes << '\n';
+  }
+
+  std::pressure_thresholds thresholds() const {
+    std::pressure_thresholds t;
+    t.poll_interval = std::chrono::milliseconds{1};
+    t.proc_root = dir;
+    t.cgroup_root = dir;
+    return t;
+  }
+};
+
+
+//----------------------------------------------------
+
+TEST(PressureRssThreshold)
+{
+  FakeRoot root;
+  auto t = root.thresholds();
+  t.rss_bytes = 100 * static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+  std::pressure_stop_source s{t};
+  std::atomic<bool> executed{false};
+  std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!s.stop_requested());
+  CHECK(s.reason() == std::pressure_reason::none);
+
+  root.setRssPages(100);
+  CHECK(waitFor([&] { return executed.load(); }));
+  CHECK(s.reason() == std::pressure_reason::rss);
+}
+
+
+//----------------------------------------------------
+
+TEST(PressureCgroupThreshold)
+{
+  FakeRoot root;
+  auto t = root.thresholds();
+  t.cgroup_bytes = 1'000'000;
+  std::pressure_stop_source s{t};
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  CHECK(!s.stop_requested());
+
+  root.setCgroupBytes(2'000'000);
+  CHECK(waitFor([&] { return s.stop_requested(); }));
+  CHECK(s.reason() == std::pressure_reason::cgroup);
+}
+
+
+//----------------------------------------------------
+
+TEST(PressureStoppedOtherwiseEndsMonitor)
+{
+  FakeRoot root;
+  auto t = root.thresholds();
+  t.rss_bytes = 1'000'000'000;
+  t.poll_interval = std::chrono::hours{1};   // must not wait for the poll
+  auto start = std::chrono::steady_clock::now();
+  {
+    std::pressure_stop_source s{t};
+    CHECK(s.get_stop_source().request_stop());
+    CHECK(s.reason() == std::pressure_reason::none);
+  }
+  {
+    std::pressure_stop_source s{t};   // destroyed without stop
+  }
+  CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(10));
+}
+
+
+//----------------------------------------------------
+
+TEST(PressureOnRealProcfs)
+{
+  // the current RSS is certainly above one byte
+  std::pressure_thresholds t;
+  t.rss_bytes = 1;
+  std::pressure_stop_source s{t};
+  CHECK(waitFor([&] { return s.stop_requested(); }));
+  CHECK(s.reason() == std::pressure_reason::rss);
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shared_stop_source.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+// run f in a forked child; return its exit status
+template <typename F>
+static int runInChild(F f)
+{
+  ::pid_t pid = ::fork();
+  if (pid == 0) {
+    ::_exit(f());
+  }
+  int status = -1;
+  ::waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+template <typename Pred>
+static bool waitFor(Pred pred)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+
+//----------------------------------------------------
+
+TEST(SharedSourceLocalStop)
+{
+  std::shared_stop_source s;
+  CHECK(!s.stop_requested());
+  std::stop_token t = s.get_token();
+  CHECK(t.stop_possible());
+
+  bool executed = false;
+  std::stop_callback cb{t, [&] { executed = true; }};
+  CHECK(s.request_stop());
+  CHECK(!s.request_stop());
+  CHECK(executed);
+  CHECK(s.stop_requested());
+  CHECK(t.stop_requested());
+  s.wait();
+}
+
+
+//----------------------------------------------------
+
+TEST(SharedSourceStopFromChildRunsLocalCallbacks)
+{
+  std::shared_stop_source s;
+  std::atomic<bool> executed{false};
+  std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+
+  // the child has its own copy of the callback, which must not matter here
+  CHECK(runInChild([&] { return s.request_stop() ? 0 : 1; }) == 0);
+  CHECK(s.stop_requested());
+  CHECK(waitFor([&] { return executed.load(); }));
+  CHECK(!s.request_stop());
+}
+
+
+//----------------------------------------------------
+
+TEST(SharedSourceStopFromParentWakesChild)
+{
+  std::shared_stop_source s;
+  ::pid_t pid = ::fork();
+  if (pid == 0) {
+    // child: wait for stop via a local callback
+    std::atomic<bool> executed{false};
+    std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+    s.wait();
+    ::_exit(waitFor([&] { return executed.load(); }) ? 0 : 1);
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  CHECK(s.request_stop());
+  int status = -1;
+  ::waitpid(pid, &status, 0);
+  CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+
+//----------------------------------------------------
+
+TEST(SharedSourceNamedSegment)
+{
+  std::string name = "/jthread_test_" + std::to_string(::getpid());
+  std::shared_stop_source s1{name.c_str()};
+  std::shared_stop_source s2{name.c_str()};   // separate mapping, same word
+  CHECK(s1 != s2);
+  CHECK(std::shared_stop_source::unlink(name.c_str()));
+  CHECK(!std::shared_stop_source::unlink(name.c_str()));
+
+  std::atomic<int> executed{0};
+  std::stop_callback cb{s2.get_token(), [&] { ++executed; }};
+  CHECK(s1.request_stop());
+  CHECK(s2.stop_requested());
+  CHECK(waitFor([&] { return executed.load() == 1; }));
+  CHECK(!s2.request_stop());
+
+  auto s3 = s2;
+  CHECK(s3 == s2);
+  CHECK(s3.get_token().stop_requested());
+}
+
+
+//----------------------------------------------------
+
+TEST(SharedSourceDestroyedWithoutStop)
+{
+  // the watcher is woken without requesting stop
+  std::shared_stop_source s;
+  std::stop_token t = s.get_token();
+  {
+    std::shared_stop_source s2 = s;
+  }
+  CHECK(!t.stop_requested());
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <utility>
+
+#include "signal_stop_source.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+template <typename Pred>
+static bool waitFor(Pred pred)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+static std::atomic<int> previousHandlerCalls{0};
+
+static void previousHandler(int)
+{
+  ++previousHandlerCalls;
+}
+
+
+//----------------------------------------------------
+
+TEST(SignalRequestsStopOnBridgeThread)
+{
+  std::signal_stop_source s;
+  std::atomic<bool> executed{false};
+  std::atomic<bool> onOtherThread{false};
+  auto mainId = std::this_thread::get_id();
+  std::stop_callback cb{s.get_token(), [&] {
+    onOtherThread = std::this_thread::get_id() != mainId;
+    executed = true;
+  }};
+  CHECK(s.signal() == 0);
+  CHECK(!s.stop_requested());
+
+  std::raise(SIGTERM);
+  CHECK(waitFor([&] { return executed.load(); }));
+  CHECK(onOtherThread);
+  CHECK(s.signal() == SIGTERM);
+  CHECK(s.stop_requested());
+  CHECK(s.get_token().stop_requested());
+}
+
+
+//----------------------------------------------------
+
+TEST(SignalBeforeFirstToken)
+{
+  // no thread is started before the first token
+  std::signal_stop_source s{SIGUSR1};
+  std::raise(SIGUSR1);
+  CHECK(s.signal() == SIGUSR1);
+  CHECK(std::as_const(s).stop_requested());   // without forwarding it
+  CHECK(s.get_token().stop_requested());
+  bool executed = false;
+  std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+  CHECK(executed);
+}
+
+
+//----------------------------------------------------
+
+TEST(SignalSourceRestoresPreviousHandlers)
+{
+  std::signal(SIGUSR2, previousHandler);
+  {
+    std::signal_stop_source s{SIGUSR2};
+    std::stop_token t = s.get_token();
+
+    // only one at a time
+    bool thrown = false;
+    try {
+      std::signal_stop_source s2{SIGUSR1};
+    }
+    catch (const std::system_error&) {
+      thrown = true;
+    }
+    CHECK(thrown);
+
+    // stop without a signal
+    s.get_stop_source().request_stop();
+    CHECK(t.stop_requested());
+    CHECK(s.signal() == 0);
+  }
+  std::raise(SIGUSR2);
+  CHECK(previousHandlerCalls == 1);
+  std::signal(SIGUSR2, SIG_DFL);
+
+  std::signal_stop_source again{SIGUSR2};
+  CHECK(!again.stop_requested());
+}
+
+
+//----------------------------------------------------
+
+TEST(SignalSourceDestroyedWithoutSignal)
+{
+  std::signal_stop_source s;
+  std::stop_token t = s.get_token();
+  CHECK(!t.stop_requested());
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
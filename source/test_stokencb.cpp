@@ -8,6 +8,7 @@
 #include <functional>
 #include <condition_variable>
 #include <mutex>
+#include <vector>
 
 //#define SAFE
 #include "stop_token.hpp"
@@ -424,6 +425,177 @@ TEST(CancellationSingleThreadPerformance)
 }
 
 
+//----------------------------------------------------
+
+static_assert(std::stoppable_token<std::stop_token>);
+static_assert(!std::unstoppable_token<std::stop_token>);
+static_assert(std::stoppable_token<std::never_stop_token>);
+static_assert(std::unstoppable_token<std::never_stop_token>);
+static_assert(!std::stoppable_token<std::stop_source>);
+static_assert(!std::stoppable_token<int>);
+static_assert(std::is_same_v<
+    std::stop_callback_for_t<std::stop_token, std::function<void()>>,
+    std::stop_callback<std::function<void()>>>);
+static_assert(std::is_empty_v<
+    std::stop_callback_for_t<std::never_stop_token, std::function<void()>>>);
+
+TEST(NeverStopTokenIsNeverStoppable)
+{
+  constexpr std::never_stop_token t;
+  static_assert(!t.stop_requested());
+  static_assert(!t.stop_possible());
+  static_assert(t == std::never_stop_token{});
+
+  bool callbackExecuted = false;
+  {
+    std::stop_callback_for_t<std::never_stop_token, std::function<void()>> cb{
+      t, [&] { callbackExecuted = true; }
+    };
+  }
+  CHECK(!callbackExecuted);
+}
+
+
+//----------------------------------------------------
+
+TEST(RelocatableCallbacksInVector)
+{
+  std::stop_source s;
+  std::atomic<int> executed{0};
+  struct Increment {    // move assignable (for erase())
+    std::atomic<int>* counter;
+    void operator()() const { ++*counter; }
+  };
+  Increment inc{&executed};
+  std::vector<std::relocatable_stop_callback<Increment>> callbacks;
+  for (int i = 0; i < 100; ++i) {
+    // reallocations relocate the registered callbacks
+    callbacks.emplace_back(s.get_token(), inc);
+  }
+  callbacks.erase(callbacks.begin(), callbacks.begin() + 10);
+  CHECK(executed == 0);
+  s.request_stop();
+  CHECK(executed == 90);
+
+  // after execution, moved-to callbacks are no longer registered
+  auto moved = std::move(callbacks);
+  CHECK(executed == 90);
+
+  // registering after stop: executed immediately
+  callbacks.emplace_back(s.get_token(), inc);
+  CHECK(executed == 91);
+}
+
+
+//----------------------------------------------------
+
+TEST(RelocatableCallbackMoveAssignment)
+{
+  std::stop_source s1;
+  std::stop_source s2;
+  int executed1 = 0;
+  int executed2 = 0;
+  std::relocatable_stop_callback<std::function<void()>> cb1{
+      s1.get_token(), [&] { ++executed1; }};
+  std::relocatable_stop_callback<std::function<void()>> cb2{
+      s2.get_token(), [&] { ++executed2; }};
+
+  cb1 = std::move(cb2);   // cb1 now belongs to s2, the s1 registration is gone
+  s1.request_stop();
+  CHECK(executed1 == 0);
+  CHECK(executed2 == 0);
+  s2.request_stop();
+  CHECK(executed1 == 0);
+  CHECK(executed2 == 1);
+
+  // move assign to a callback that has been executed, then register again:
+  std::stop_source s3;
+  std::relocatable_stop_callback<std::function<void()>> cb3{
+      s3.get_token(), [&] { ++executed1; }};
+  cb1 = std::move(cb3);
+  s3.request_stop();
+  CHECK(executed1 == 1);
+}
+
+
+//----------------------------------------------------
+
+TEST(RelocatableCallbackMovedWhileStopIsRequested)
+{
+  for (int i = 0; i < 200; ++i) {
+    std::stop_source s;
+    std::atomic<int> executed{0};
+    auto inc = [&executed] { ++executed; };
+    using callback_t = std::relocatable_stop_callback<decltype(inc)>;
+    std::vector<callback_t> callbacks;
+    for (int j = 0; j < 20; ++j) {
+      callbacks.emplace_back(s.get_token(), inc);
+    }
+
+    std::thread stopper{[&] { s.request_stop(); }};
+    // keep relocating while the other thread runs the callbacks:
+    for (int j = 0; j < 10; ++j) {
+      std::vector<callback_t> tmp;
+      tmp.reserve(callbacks.size());
+      for (auto& cb : callbacks) {
+        tmp.push_back(std::move(cb));
+      }
+      callbacks = std::move(tmp);
+    }
+    stopper.join();
+    CHECK(executed == 20);
+  }
+}
+
+
+//----------------------------------------------------
+
+TEST(RelocatableCallbackMoveThrows)
+{
+  struct ThrowingMove {
+    int* counter;
+    bool throwOnMove = true;
+    ThrowingMove(int* c) : counter{c} {}
+    ThrowingMove(ThrowingMove&& other) : counter{other.counter} {
+      if (other.throwOnMove) {
+        throw 42;
+      }
+    }
+    ThrowingMove& operator=(ThrowingMove&& other) {
+      if (other.throwOnMove) {
+        throw 42;
+      }
+      counter = other.counter;
+      return *this;
+    }
+    void operator()() const { ++*counter; }
+  };
+  std::stop_source s;
+  int executed = 0;
+  std::relocatable_stop_callback<ThrowingMove> cb{s.get_token(), &executed};
+  std::relocatable_stop_callback<ThrowingMove> other{s.get_token(), &executed};
+  bool thrown = false;
+  try {
+    std::relocatable_stop_callback<ThrowingMove> moved{std::move(cb)};
+  }
+  catch (int) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  thrown = false;
+  try {
+    other = std::move(cb);
+  }
+  catch (int) {
+    thrown = true;
+  }
+  CHECK(thrown);
+  // cb is still registered (other is no longer)
+  s.request_stop();
+  CHECK(executed == 1);
+}
+
+
 //----------------------------------------------------
 
 int main()
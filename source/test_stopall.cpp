@@ -0,0 +1,154 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <optional>
+#include <functional>
+
+#include "stop_token.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+TEST(RequestStopAllSignalsAllSources)
+{
+  std::vector<std::stop_source> sources(100);
+  sources.push_back(std::stop_source{std::nostopstate});
+  sources.push_back(sources.front());      // same state twice
+  sources[1].request_stop();               // already stopped
+
+  std::atomic<int> executed{0};
+  std::vector<std::unique_ptr<std::stop_callback<std::function<void()>>>> callbacks;
+  for (auto& s : sources) {
+    callbacks.push_back(std::make_unique<std::stop_callback<std::function<void()>>>(
+        s.get_token(), [&executed] { ++executed; }));
+  }
+  CHECK(executed == 1);   // the one registered after stop
+
+  CHECK(std::request_stop_all(sources) == 99);
+  CHECK(executed == 101);  // duplicate state: both callbacks, executed once
+  for (std::size_t i = 0; i < 100; ++i) {
+    CHECK(sources[i].stop_requested());
+  }
+  CHECK(!sources[100].stop_requested());
+
+  CHECK(std::request_stop_all(sources.begin(), sources.end()) == 0);
+  CHECK(executed == 101);
+}
+
+
+//----------------------------------------------------
+
+TEST(RequestStopAllSeesAllFlagsBeforeCallbacks)
+{
+  // callbacks of the first source can already see the last one stopped
+  std::vector<std::stop_source> sources(10);
+  bool lastStoppedInFirstCallback = false;
+  std::stop_callback cb{sources.front().get_token(), [&] {
+    lastStoppedInFirstCallback = sources.back().stop_requested();
+  }};
+  std::request_stop_all(sources);
+  CHECK(lastStoppedInFirstCallback);
+}
+
+
+//----------------------------------------------------
+
+TEST(RequestStopAllWithWorkers)
+{
+  std::vector<std::stop_source> sources(1000);
+  sources.emplace_back(std::sharded_stop_state, 4);
+  std::atomic<int> executed{0};
+  std::vector<std::unique_ptr<std::stop_callback<std::function<void()>>>> callbacks;
+  for (auto& s : sources) {
+    for (int i = 0; i < 3; ++i) {
+      callbacks.push_back(std::make_unique<std::stop_callback<std::function<void()>>>(
+          s.get_token(), [&executed] { ++executed; }));
+    }
+  }
+  CHECK(std::request_stop_all(sources, 4) == 1001);
+  CHECK(executed == 3003);
+
+  // callbacks may deregister while the workers execute others
+  callbacks.clear();
+}
+
+
+//----------------------------------------------------
+
+TEST(RequestStopAllUnsynchronized)
+{
+  std::vector<std::unsynchronized_stop_source> sources(10);
+  int executed = 0;
+  std::unsynchronized_stop_callback cb{sources[5].get_token(), [&] { ++executed; }};
+  CHECK(std::request_stop_all(sources) == 10);
+  CHECK(executed == 1);
+}
+
+
+//----------------------------------------------------
+
+// benchmark: cancel a batch of 50k requests with one callback each
+TEST(RequestStopAllPerformance)
+{
+  constexpr int batchSize = 50'000;
+  auto onStop = []{};
+  using callback_t = std::stop_callback<decltype(onStop)>;
+
+  auto report = [](const char* label, auto time)
+  {
+    auto us = std::chrono::duration<double, std::micro>(time).count();
+    std::cout << label << " took " << us << "us (" << (us * 1000.0 / batchSize) << " ns/source)" << std::endl;
+  };
+
+  auto measure = [&](auto cancel) {
+    std::vector<std::stop_source> sources(batchSize);
+    std::vector<std::optional<callback_t>> callbacks(batchSize);
+    for (int i = 0; i < batchSize; ++i) {
+      callbacks[i].emplace(sources[i].get_token(), onStop);
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    cancel(sources);
+    return std::chrono::high_resolution_clock::now() - start;
+  };
+
+  // interleave the variants and report the best of some runs
+  using duration_t = std::chrono::high_resolution_clock::duration;
+  duration_t loop = duration_t::max(), batch = loop, parallel = loop;
+  unsigned workers = std::thread::hardware_concurrency();
+  workers = workers > 4 ? 4 : workers;
+  for (int run = 0; run < 5; ++run) {
+    loop = std::min(loop, measure([](auto& sources) {
+      for (auto& s : sources) {
+        s.request_stop();
+      }
+    }));
+    batch = std::min(batch, measure([](auto& sources) {
+      std::request_stop_all(sources);
+    }));
+    parallel = std::min(parallel, measure([workers](auto& sources) {
+      std::request_stop_all(sources, workers);
+    }));
+  }
+  report("request_stop() loop        ", loop);
+  report("request_stop_all()         ", batch);
+  report("request_stop_all(, workers)", parallel);
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
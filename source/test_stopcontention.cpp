@@ -0,0 +1,201 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <optional>
+#include <functional>
+
+#include "stop_token.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+TEST(ShardedSourceRunsCallbacksOfAllThreads)
+{
+  std::stop_source s{std::sharded_stop_state, 4};
+  CHECK(s.stop_possible());
+  CHECK(!s.stop_requested());
+
+  constexpr int threadCount = 8;
+  std::atomic<int> registered{0};
+  std::atomic<int> executed{0};
+  std::atomic<bool> stopped{false};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < threadCount; ++i) {
+    threads.emplace_back([&] {
+      std::stop_callback cb{s.get_token(), [&] { ++executed; }};
+      ++registered;
+      while (!stopped.load()) {
+        std::this_thread::yield();
+      }
+    });
+  }
+
+  while (registered.load() < threadCount) {
+    std::this_thread::yield();
+  }
+  CHECK(s.request_stop());
+  CHECK(!s.request_stop());
+  CHECK(executed.load() == threadCount);
+  stopped = true;
+  for (auto& t : threads) {
+    t.join();
+  }
+}
+
+
+//----------------------------------------------------
+
+TEST(ShardedSourceDeregistrationAndLateRegistration)
+{
+  std::stop_source s{std::sharded_stop_state};
+  bool executed = false;
+  {
+    std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+  }
+  s.request_stop();
+  CHECK(!executed);
+
+  // registered after stop was requested: executes immediately
+  std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+  CHECK(executed);
+  CHECK(s.get_token().stop_requested());
+}
+
+
+//----------------------------------------------------
+
+TEST(ShardedSourceCallbackDeregisteredFromWithinCallback)
+{
+  std::stop_source s{std::sharded_stop_state, 2};
+  std::optional<std::stop_callback<std::function<void()>>> cb;
+  bool executed = false;
+  cb.emplace(s.get_token(), [&] { executed = true; cb.reset(); });
+  s.request_stop();
+  CHECK(executed);
+  CHECK(!cb.has_value());
+}
+
+
+//----------------------------------------------------
+
+TEST(ShardedSourceTokenOutlivesSource)
+{
+  std::stop_token t;
+  {
+    std::stop_source s{std::sharded_stop_state};
+    t = s.get_token();
+    CHECK(t.stop_possible());
+  }
+  CHECK(!t.stop_possible());
+  bool executed = false;
+  std::stop_callback cb{t, [&] { executed = true; }};
+  CHECK(!executed);
+}
+
+
+//----------------------------------------------------
+
+// benchmark: registration/deregistration throughput on one shared source
+TEST(RegistrationContentionPerformance)
+{
+  constexpr int iterationCount = 100'000;
+
+  auto measure = [](const std::stop_source& s, unsigned threadCount) {
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < threadCount; ++i) {
+      threads.emplace_back([&] {
+        auto token = s.get_token();
+        while (!go.load()) {
+          std::this_thread::yield();
+        }
+        for (int j = 0; j < iterationCount; ++j) {
+          std::stop_callback cb{token, []{}};
+        }
+      });
+    }
+    auto start = std::chrono::high_resolution_clock::now();
+    go = true;
+    for (auto& t : threads) {
+      t.join();
+    }
+    return std::chrono::high_resolution_clock::now() - start;
+  };
+
+  auto report = [](const char* label, unsigned threadCount, auto time)
+  {
+    auto ms = std::chrono::duration<double, std::milli>(time).count();
+    auto ops = static_cast<double>(threadCount) * iterationCount;
+    std::cout << label << " with " << threadCount << " threads took " << ms
+              << "ms (" << (ops / ms / 1000.0) << " Mops/s)" << std::endl;
+  };
+
+  // sharded registrations only touch their shard's cache line, so their
+  // throughput should grow with the thread count (up to the core count),
+  // while that of the single list stays flat
+  unsigned maxThreads = std::thread::hardware_concurrency();
+  if (maxThreads < 2) {
+    maxThreads = 2;
+  }
+  for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+    std::stop_source single;
+    report("Single list", threadCount, measure(single, threadCount));
+    std::stop_source sharded{std::sharded_stop_state};
+    report("Sharded    ", threadCount, measure(sharded, threadCount));
+  }
+}
+
+
+//----------------------------------------------------
+
+TEST(ShardedSourceCallbacksOutliveSourceAndTokens)
+{
+  // callbacks registered by many threads, destroyed after the last
+  // source and token (the state goes with the last shard reference)
+  constexpr int threadCount = 8;
+  using callback_t = std::stop_callback<std::function<void()>>;
+  std::vector<std::optional<callback_t>> callbacks(threadCount);
+  {
+    std::stop_source s{std::sharded_stop_state, 4};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < threadCount; ++i) {
+      threads.emplace_back([&, i] {
+        callbacks[i].emplace(s.get_token(), [] {});
+        std::stop_token t = s.get_token();
+        callback_t moved{std::move(t), [] {}};
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+  }
+  for (auto& cb : callbacks) {
+    cb.reset();
+  }
+
+  int executed = 0;
+  {
+    std::stop_source s{std::sharded_stop_state, 2};
+    callbacks[0].emplace(s.get_token(), [&] { ++executed; });
+    s.request_stop();
+  }
+  callbacks[0].reset();
+  CHECK(executed == 1);
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
@@ -0,0 +1,222 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <cstdio>
+#include <cstddef>
+#include <cerrno>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "stop_io.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+static bool isReadable(int fd)
+{
+  ::pollfd pfd{fd, POLLIN, 0};
+  return ::poll(&pfd, 1, 0) == 1;
+}
+
+// request stop from another thread after a short delay
+static std::thread stopLater(std::stop_source s)
+{
+  return std::thread{[s] () mutable {
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    s.request_stop();
+  }};
+}
+
+
+//----------------------------------------------------
+
+TEST(NativeEventfdBecomesReadable)
+{
+  std::stop_token none;
+  CHECK(none.native_eventfd() == -1);
+
+  std::stop_source s;
+  int fd = s.get_token().native_eventfd();
+  CHECK(fd >= 0);
+  CHECK(s.get_token().native_eventfd() == fd);   // one per state
+  CHECK(!isReadable(fd));
+  s.request_stop();
+  CHECK(isReadable(fd));
+  CHECK(isReadable(fd));                          // stays readable
+
+  // created after stop was requested
+  std::stop_source s2;
+  s2.request_stop();
+  CHECK(isReadable(s2.get_token().native_eventfd()));
+
+  std::stop_source sharded{std::sharded_stop_state, 2};
+  int fd3 = sharded.get_token().native_eventfd();
+  std::request_stop_all(&sharded, &sharded + 1);
+  CHECK(isReadable(fd3));
+}
+
+
+//----------------------------------------------------
+
+TEST(StoppableReadFromPipe)
+{
+  int fds[2];
+  CHECK(::pipe(fds) == 0);
+  std::stop_source s;
+  char buf[8] = {};
+
+  // data available: plain read
+  CHECK(::write(fds[1], "abc", 3) == 3);
+  CHECK(std::stoppable_read(fds[0], buf, sizeof(buf), s.get_token()) == 3);
+  CHECK(std::strncmp(buf, "abc", 3) == 0);
+
+  // blocked until stop is requested
+  auto t = stopLater(s);
+  errno = 0;
+  CHECK(std::stoppable_read(fds[0], buf, sizeof(buf), s.get_token()) == -1);
+  CHECK(errno == ECANCELED);
+  t.join();
+
+  // already stopped
+  CHECK(::write(fds[1], "x", 1) == 1);
+  CHECK(std::stoppable_read(fds[0], buf, sizeof(buf), s.get_token()) == -1);
+
+  // no stop state: plain blocking read
+  CHECK(std::stoppable_read(fds[0], buf, sizeof(buf), std::stop_token{}) == 1);
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+
+//----------------------------------------------------
+
+TEST(StoppableWriteToFullSocket)
+{
+  int fds[2];
+  CHECK(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+  ::fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  std::stop_source s;
+  char buf[4096] = {};
+  ::ssize_t written = 0;
+  while (::write(fds[0], buf, sizeof(buf)) > 0) {
+    ++written;
+  }
+  CHECK(written > 0);
+
+  // non-blocking fd: waits instead of EAGAIN, until stop is requested
+  auto t = stopLater(s);
+  CHECK(std::stoppable_write(fds[0], buf, sizeof(buf), s.get_token()) == -1);
+  CHECK(errno == ECANCELED);
+  t.join();
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+
+//----------------------------------------------------
+
+TEST(StoppableAccept)
+{
+  int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK(listener >= 0);
+  ::sockaddr_un addr{};
+  addr.sun_family = AF_UNIX;
+  // abstract socket name (leading '\0')
+  std::snprintf(addr.sun_path + 1, sizeof(addr.sun_path) - 1,
+                "jthread_test_%d", static_cast<int>(::getpid()));
+  auto len = static_cast<::socklen_t>(offsetof(::sockaddr_un, sun_path) + 1 +
+                                      std::strlen(addr.sun_path + 1));
+  CHECK(::bind(listener, reinterpret_cast<::sockaddr*>(&addr), len) == 0);
+  CHECK(::listen(listener, 4) == 0);
+
+  std::stop_source s;
+  int client = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  CHECK(::connect(client, reinterpret_cast<::sockaddr*>(&addr), len) == 0);
+  int accepted = std::stoppable_accept(listener, nullptr, nullptr, s.get_token());
+  CHECK(accepted >= 0);
+
+  auto t = stopLater(s);
+  CHECK(std::stoppable_accept(listener, nullptr, nullptr, s.get_token()) == -1);
+  CHECK(errno == ECANCELED);
+  t.join();
+  ::close(accepted);
+  ::close(client);
+  ::close(listener);
+}
+
+
+//----------------------------------------------------
+
+TEST(StoppablePoll)
+{
+  int fds[2];
+  CHECK(::pipe(fds) == 0);
+  std::stop_source s;
+  ::pollfd pfd{fds[0], POLLIN, 0};
+  CHECK(std::stoppable_poll(&pfd, 1, 0, s.get_token()) == 0);    // timeout
+  CHECK(::write(fds[1], "x", 1) == 1);
+  CHECK(std::stoppable_poll(&pfd, 1, -1, s.get_token()) == 1);
+  CHECK(pfd.revents == POLLIN);
+
+  char c;
+  CHECK(::read(fds[0], &c, 1) == 1);
+  auto t = stopLater(s);
+  CHECK(std::stoppable_poll(&pfd, 1, -1, s.get_token()) == -1);
+  CHECK(errno == ECANCELED);
+  t.join();
+  ::close(fds[0]);
+  ::close(fds[1]);
+}
+
+
+//----------------------------------------------------
+
+TEST(StoppablePollManyFds)
+{
+  // more fds than fit into the stack buffer
+  constexpr int count = 40;
+  int fds[count][2];
+  std::vector<::pollfd> pfds;
+  for (auto& p : fds) {
+    CHECK(::pipe(p) == 0);
+    pfds.push_back({p[0], POLLIN, 0});
+  }
+  std::stop_source s;
+  CHECK(::write(fds[count - 1][1], "x", 1) == 1);
+  CHECK(std::stoppable_poll(pfds.data(), pfds.size(), -1, s.get_token()) == 1);
+  CHECK(pfds[count - 1].revents == POLLIN);
+  CHECK(pfds[0].revents == 0);
+
+  char c;
+  CHECK(::read(fds[count - 1][0], &c, 1) == 1);
+  auto t = stopLater(s);
+  CHECK(std::stoppable_poll(pfds.data(), pfds.size(), -1, s.get_token()) == -1);
+  CHECK(errno == ECANCELED);
+  t.join();
+  for (auto& p : fds) {
+    ::close(p[0]);
+    ::close(p[1]);
+  }
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
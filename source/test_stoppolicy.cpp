@@ -0,0 +1,232 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <cstdint>
+#include <optional>
+#include <functional>
+
+#include "stop_token.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+// policy with counted allocations and a 32-bit state word
+struct counting_policy : std::default_stop_policy {
+  using word_type = std::uint32_t;
+  static constexpr unsigned source_ref_shift = 17;
+
+  static inline std::atomic<int> allocations{0};
+  static inline std::atomic<int> deallocations{0};
+
+  static void* allocate(std::size_t n) {
+    ++allocations;
+    return ::operator new(n);
+  }
+  static void deallocate(void* p, std::size_t n) noexcept {
+    ++deallocations;
+    ::operator delete(p, n);
+  }
+};
+
+using counting_stop_source = std::basic_stop_source<counting_policy>;
+using counting_stop_token = std::basic_stop_token<counting_policy>;
+
+static_assert(std::stoppable_token<counting_stop_token>);
+static_assert(std::is_same_v<
+    std::stop_callback_for_t<counting_stop_token, void(*)()>,
+    std::basic_stop_callback<void(*)(), counting_policy>>);
+static_assert(std::is_same_v<std::stop_source,
+                             std::basic_stop_source<std::default_stop_policy>>);
+
+
+//----------------------------------------------------
+
+TEST(PolicyAllocatesAndDeallocatesState)
+{
+  auto allocs = counting_policy::allocations.load();
+  auto deallocs = counting_policy::deallocations.load();
+  {
+    counting_stop_token t;
+    {
+      counting_stop_source s;
+      CHECK(counting_policy::allocations == allocs + 1);
+      t = s.get_token();
+      auto s2 = s;
+      CHECK(s2 == s);
+    }
+    CHECK(!t.stop_possible());
+    CHECK(counting_policy::deallocations == deallocs);
+  }
+  CHECK(counting_policy::deallocations == deallocs + 1);
+
+  counting_stop_source none{std::nostopstate};
+  CHECK(!none.stop_possible());
+  CHECK(counting_policy::allocations == allocs + 1);
+
+  // the shards of a sharded state, too
+  {
+    counting_stop_source sharded{std::sharded_stop_state, 3};
+    CHECK(counting_policy::allocations == allocs + 3);
+    bool executed = false;
+    std::basic_stop_callback cb{sharded.get_token(), [&] { executed = true; }};
+    sharded.request_stop();
+    CHECK(executed);
+  }
+  CHECK(counting_policy::deallocations == deallocs + 3);
+}
+
+
+//----------------------------------------------------
+
+TEST(PolicyCallbacksAreExecuted)
+{
+  counting_stop_source s;
+  int executed = 0;
+  std::basic_stop_callback cb1{s.get_token(), [&] { ++executed; }};
+  {
+    std::basic_stop_callback cb2{s.get_token(), [&] { executed += 10; }};
+  }
+  CHECK(s.request_stop());
+  CHECK(executed == 1);
+  CHECK(s.get_token().stop_requested());
+  std::basic_stop_callback cb3{s.get_token(), [&] { executed += 100; }};
+  CHECK(executed == 101);
+}
+
+
+//----------------------------------------------------
+
+TEST(PolicyManyTokenReferences)
+{
+  // 14 bits for token references with the 32-bit layout
+  counting_stop_source s;
+  std::vector<counting_stop_token> tokens(10'000, s.get_token());
+  std::vector<counting_stop_source> sources(10'000, s);
+  sources.clear();
+  CHECK(tokens.back().stop_possible());
+  s.request_stop();
+  CHECK(tokens.front().stop_requested());
+}
+
+
+//----------------------------------------------------
+
+TEST(YieldingPolicyConcurrentCallbacks)
+{
+  std::basic_stop_source<std::yielding_stop_policy> s;
+  std::atomic<int> executed{0};
+  std::vector<std::thread> threads;
+  for (int i = 0; i < 4; ++i) {
+    threads.emplace_back([&] {
+      for (int j = 0; j < 1000; ++j) {
+        std::basic_stop_callback cb{s.get_token(), [&] { ++executed; }};
+      }
+    });
+  }
+  std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  s.request_stop();
+  for (auto& t : threads) {
+    t.join();
+  }
+  CHECK(s.stop_requested());
+}
+
+
+//----------------------------------------------------
+
+static_assert(std::stoppable_token<std::unsynchronized_stop_token>);
+static_assert(std::is_same_v<
+    std::stop_callback_for_t<std::unsynchronized_stop_token, void(*)()>,
+    std::unsynchronized_stop_callback<void(*)()>>);
+
+TEST(UnsynchronizedSourceAPI)
+{
+  std::unsynchronized_stop_source s;
+  std::unsynchronized_stop_token t = s.get_token();
+  CHECK(t.stop_possible());
+  CHECK(!t.stop_requested());
+
+  int executed = 0;
+  std::unsynchronized_stop_callback cb1{t, [&] { ++executed; }};
+  {
+    std::unsynchronized_stop_callback cb2{t, [&] { executed += 10; }};
+  }
+  std::optional<std::unsynchronized_stop_callback<std::function<void()>>> cb3;
+  cb3.emplace(t, [&] { executed += 100; cb3.reset(); });
+
+  CHECK(s.request_stop());
+  CHECK(!s.request_stop());
+  CHECK(executed == 101);
+  CHECK(!cb3.has_value());
+  CHECK(t.stop_requested());
+
+  std::unsynchronized_stop_callback cb4{t, [&] { executed += 1000; }};
+  CHECK(executed == 1101);
+
+  std::unsynchronized_stop_token t2;
+  {
+    std::unsynchronized_stop_source s2;
+    t2 = s2.get_token();
+  }
+  CHECK(!t2.stop_possible());
+}
+
+
+//----------------------------------------------------
+
+// benchmark: per-operation life cycle in an event loop
+// (create source, register callback, cancel or deregister)
+template <typename Source, template <typename> class Callback>
+static auto measureOperationLifeCycle(int iterationCount)
+{
+  int executed = 0;
+  auto start = std::chrono::high_resolution_clock::now();
+  for (int i = 0; i < iterationCount; ++i) {
+    Source s;
+    auto onStop = [&executed] { ++executed; };
+    Callback<decltype(onStop)> cb{s.get_token(), onStop};
+    if (i % 2 == 0) {
+      s.request_stop();
+    }
+  }
+  auto end = std::chrono::high_resolution_clock::now();
+  assert(executed == (iterationCount + 1) / 2);
+  return end - start;
+}
+
+TEST(UnsynchronizedSourcePerformance)
+{
+  constexpr int iterationCount = 500'000;
+
+  auto report = [](const char* label, auto time, std::uint64_t count)
+  {
+    auto ms = std::chrono::duration<double, std::milli>(time).count();
+    auto ns = std::chrono::duration<double, std::nano>(time).count();
+    std::cout << label << " took " << ms << "ms (" << (ns / static_cast<double>(count)) << " ns/item)" << std::endl;
+  };
+
+  report("stop_source               ",
+         measureOperationLifeCycle<std::stop_source, std::stop_callback>(iterationCount),
+         iterationCount);
+  report("unsynchronized_stop_source",
+         measureOperationLifeCycle<std::unsynchronized_stop_source,
+                                   std::unsynchronized_stop_callback>(iterationCount),
+         iterationCount);
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
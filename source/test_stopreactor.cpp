@@ -0,0 +1,140 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "stop_reactor.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+template <typename Pred>
+static bool waitFor(Pred pred)
+{
+  auto end = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (!pred()) {
+    if (std::chrono::steady_clock::now() > end) {
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  return true;
+}
+
+
+//----------------------------------------------------
+
+TEST(ReactorStopsWhenFdBecomesReadable)
+{
+  int fds[2];
+  CHECK(::pipe(fds) == 0);
+  std::stop_source s;
+  std::request_stop_on(s, fds[0]);
+  ::close(fds[0]);   // the reactor watches a duplicate
+  std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CHECK(!s.stop_requested());
+
+  CHECK(::write(fds[1], "x", 1) == 1);
+  CHECK(waitFor([&] { return s.stop_requested(); }));
+  ::close(fds[1]);
+}
+
+
+//----------------------------------------------------
+
+TEST(ReactorStopsOnTimeout)
+{
+  std::stop_source s;
+  std::atomic<bool> executed{false};
+  std::stop_callback cb{s.get_token(), [&] { executed = true; }};
+  auto start = std::chrono::steady_clock::now();
+  std::request_stop_after(s, std::chrono::milliseconds(20));
+  CHECK(waitFor([&] { return executed.load(); }));
+  CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20));
+}
+
+
+//----------------------------------------------------
+
+TEST(ReactorStopsOnChildExit)
+{
+  ::pid_t pid = ::fork();
+  if (pid == 0) {
+    ::usleep(20'000);
+    ::_exit(0);
+  }
+  std::stop_source s;
+  std::request_stop_on_exit(s, pid);
+  CHECK(waitFor([&] { return s.stop_requested(); }));
+  int status = -1;
+  CHECK(::waitpid(pid, &status, 0) == pid);
+}
+
+
+//----------------------------------------------------
+
+TEST(ReactorDropsTriggerWhenStoppedOtherwise)
+{
+  std::signal(SIGPIPE, SIG_IGN);
+  int fds[2];
+  CHECK(::pipe(fds) == 0);
+  std::stop_source s;
+  std::request_stop_on(s, fds[0]);
+  ::close(fds[0]);
+  s.request_stop();
+
+  // the reactor closed its duplicate: no reader left
+  CHECK(waitFor([&] { return ::write(fds[1], "x", 1) < 0 && errno == EPIPE; }));
+  ::close(fds[1]);
+
+  // already stopped: not registered at all
+  int fds2[2];
+  CHECK(::pipe(fds2) == 0);
+  std::request_stop_on(s, fds2[0]);
+  ::close(fds2[0]);
+  CHECK(::write(fds2[1], "x", 1) < 0 && errno == EPIPE);
+  ::close(fds2[1]);
+  std::signal(SIGPIPE, SIG_DFL);
+}
+
+
+//----------------------------------------------------
+
+TEST(ReactorManyTriggers)
+{
+  // one reactor thread for all of them
+  constexpr int count = 500;
+  std::vector<std::stop_source> sources(count);
+  for (int i = 0; i < count; ++i) {
+    std::request_stop_after(sources[i], std::chrono::milliseconds(i % 20));
+  }
+  CHECK(waitFor([&] {
+    for (auto& s : sources) {
+      if (!s.stop_requested()) {
+        return false;
+      }
+    }
+    return true;
+  }));
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
@@ -0,0 +1,302 @@
+#include <iostream>
+#include <cassert>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "work_stealing_executor.hpp"
+
+#include "test.hpp"
+
+
+//----------------------------------------------------
+
+TEST(ChaseLevDequeOwnerAndThieves)
+{
+  std::__chase_lev_deque<int> deque{4};   // grows
+  constexpr int count = 100'000;
+  std::vector<int> values(count);
+  std::iota(values.begin(), values.end(), 0);
+  std::vector<std::atomic<int>> seen(count);
+
+  std::atomic<bool> done{false};
+  std::vector<std::thread> thieves;
+  for (int i = 0; i < 3; ++i) {
+    thieves.emplace_back([&] {
+      while (!done || !deque.__empty()) {
+        if (int* p = deque.__steal()) {
+          ++seen[*p];
+        }
+      }
+    });
+  }
+  for (int i = 0; i < count; ++i) {
+    deque.__push(&values[i]);
+    if (i % 3 == 0) {
+      if (int* p = deque.__take()) {
+        ++seen[*p];
+      }
+    }
+  }
+  while (int* p = deque.__take()) {
+    ++seen[*p];
+  }
+  done = true;
+  for (auto& t : thieves) {
+    t.join();
+  }
+  CHECK(std::all_of(seen.begin(), seen.end(), [](auto& s) { return s == 1; }));
+}
+
+
+//----------------------------------------------------
+
+TEST(WorkStealingRunsForkedTasks)
+{
+  std::work_stealing_executor ex{4};
+  CHECK(ex.size() == 4);
+  std::atomic<int> count{0};
+  std::atomic<int> pending{1};
+  // each task forks two more, down to depth 10 (2047 tasks)
+  struct Fork {
+    std::work_stealing_executor& ex;
+    std::atomic<int>& count;
+    std::atomic<int>& pending;
+    int depth;
+    void operator()() const {
+      ++count;
+      if (depth > 0) {
+        pending += 2;
+        ex.submit(Fork{ex, count, pending, depth - 1});
+        ex.submit(Fork{ex, count, pending, depth - 1});
+      }
+      --pending;
+    }
+  };
+  ex.submit(Fork{ex, count, pending, 10});
+  ex.run_until([&] { return pending == 0; });
+  CHECK(count == 2047);
+}
+
+
+//----------------------------------------------------
+
+TEST(WorkStealingDropsStoppedTasks)
+{
+  std::work_stealing_executor ex{2};
+  std::stop_source cancel;
+  std::atomic<bool> blocked{false}, release{false};
+  std::atomic<int> ran{0}, finished{0};
+  // occupy both workers
+  for (int i = 0; i < 2; ++i) {
+    ex.submit([&] { blocked = true; while (!release) std::this_thread::yield(); ++finished; });
+  }
+  while (!blocked) {
+    std::this_thread::yield();
+  }
+  for (int i = 0; i < 100; ++i) {
+    ex.submit([&ran] (std::stop_token) { ++ran; }, cancel.get_token());
+  }
+  cancel.request_stop();
+  release = true;
+  std::atomic<bool> last{false};
+  ex.submit([&last] { last = true; });
+  ex.run_until([&] { return last && finished == 2; });
+  CHECK(ran == 0);
+  CHECK(ex.get_stop_token().stop_possible());
+}
+
+
+//----------------------------------------------------
+
+TEST(WorkStealingDestructorStopsWorkers)
+{
+  std::atomic<bool> stopSeen{false}, started{false};
+  {
+    std::work_stealing_executor ex{2};
+    ex.submit([&] (std::stop_token st) {
+                started = true;
+                while (!st.stop_requested()) {
+                  std::this_thread::yield();
+                }
+                stopSeen = true;
+              });
+    while (!started) {
+      std::this_thread::yield();
+    }
+  }
+  CHECK(stopSeen);
+}
+
+
+//----------------------------------------------------
+
+TEST(WorkStealingRunUntilReturnsOnStop)
+{
+  std::atomic<bool> result{true}, waiting{false}, never{false};
+  {
+    std::work_stealing_executor ex{1};
+    ex.submit([&] {
+                // waits for something that won't happen (as for a forked
+                // task dropped by the stop)
+                waiting = true;
+                result = ex.run_until([&never] { return never.load(); });
+              });
+    while (!waiting) {
+      std::this_thread::yield();
+    }
+    ex.request_stop();
+  }   // (doesn't hang)
+  CHECK(!result);
+}
+
+
+//----------------------------------------------------
+
+TEST(WorkStealingWorkerStateEndsWithWorker)
+{
+  // a worker thread parked in the jthread cache and reused by another
+  // jthread must not act as worker of a new executor at the same address
+  std::set_jthread_cache_limit(1);
+  std::optional<std::work_stealing_executor> ex;
+  ex.emplace(1);
+  std::atomic<std::thread::id> workerId{};
+  ex->submit([&workerId] { workerId = std::this_thread::get_id(); });
+  while (workerId.load() == std::thread::id{}) {
+    std::this_thread::yield();
+  }
+  ex.reset();   // the worker thread is parked
+
+  std::atomic<bool> go{false};
+  std::vector<int> order;
+  std::jthread t{[&] {
+    while (!go) {
+      std::this_thread::yield();
+    }
+    // (a worker would take these from its own deque: last one first)
+    std::atomic<int> done{0};
+    ex->submit([&] { order.push_back(1); ++done; });
+    ex->submit([&] { order.push_back(2); ++done; });
+    ex->run_until([&] { return done == 2; });
+  }};
+#ifdef JTHREAD_FUSED_START
+  CHECK(t.get_id() == workerId.load());   // reused thread
+#endif
+
+  ex.emplace(1);   // (at the same address)
+  std::atomic<bool> blocked{true}, blocking{false};
+  ex->submit([&] {
+               blocking = true;
+               while (blocked) {
+                 std::this_thread::yield();
+               }
+             });
+  while (!blocking) {
+    std::this_thread::yield();
+  }
+  go = true;
+  t.join();
+  blocked = false;
+  CHECK((order == std::vector<int>{1, 2}));   // injected: first in, first out
+  ex.reset();
+  std::set_jthread_cache_limit(0);
+}
+
+
+//----------------------------------------------------
+
+// benchmark: recursive fib and quick-sort, scaling from 1 to all cores
+
+static long fibSerial(int n)
+{
+  return n < 2 ? n : fibSerial(n - 1) + fibSerial(n - 2);
+}
+
+static long fib(std::work_stealing_executor& ex, int n)
+{
+  if (n < 20) {
+    return fibSerial(n);
+  }
+  long a = 0;
+  std::atomic<bool> done{false};
+  ex.submit([&] { a = fib(ex, n - 1); done.store(true, std::memory_order_release); });
+  long b = fib(ex, n - 2);
+  ex.run_until([&] { return done.load(std::memory_order_acquire); });
+  return a + b;
+}
+
+static void quickSort(std::work_stealing_executor& ex, int* first, int* last)
+{
+  if (last - first < 2048) {
+    std::sort(first, last);
+    return;
+  }
+  int pivot = first[(last - first) / 2];
+  int* mid1 = std::partition(first, last, [pivot](int x) { return x < pivot; });
+  int* mid2 = std::partition(mid1, last, [pivot](int x) { return x == pivot; });
+  std::atomic<bool> done{false};
+  ex.submit([&] { quickSort(ex, first, mid1); done.store(true, std::memory_order_release); });
+  quickSort(ex, mid2, last);
+  ex.run_until([&] { return done.load(std::memory_order_acquire); });
+}
+
+TEST(WorkStealingScaling)
+{
+  const unsigned cores = std::max(1u, std::jthread::hardware_concurrency());
+  std::vector<int> input(2'000'000);
+  std::mt19937 gen{42};
+  for (auto& x : input) {
+    x = static_cast<int>(gen());
+  }
+  const long expected = fibSerial(32);
+
+  std::vector<unsigned> workerCounts;
+  for (unsigned workers = 1; workers < cores; workers *= 2) {
+    workerCounts.push_back(workers);
+  }
+  workerCounts.push_back(cores);   // end with all cores
+
+  for (unsigned workers : workerCounts) {
+    std::work_stealing_executor ex{workers};
+    double fibMs = 1e9, sortMs = 1e9;
+    for (int run = 0; run < 3; ++run) {
+      auto start = std::chrono::steady_clock::now();
+      long result = 0;
+      std::atomic<bool> done{false};
+      ex.submit([&] { result = fib(ex, 32); done = true; });
+      ex.run_until([&] { return done.load(); });
+      auto mid = std::chrono::steady_clock::now();
+      CHECK(result == expected);
+
+      auto data = input;
+      auto sortStart = std::chrono::steady_clock::now();
+      done = false;
+      ex.submit([&] { quickSort(ex, data.data(), data.data() + data.size()); done = true; });
+      ex.run_until([&] { return done.load(); });
+      auto end = std::chrono::steady_clock::now();
+      CHECK(std::is_sorted(data.begin(), data.end()));
+
+      fibMs = std::min(fibMs, std::chrono::duration<double, std::milli>(mid - start).count());
+      sortMs = std::min(sortMs, std::chrono::duration<double, std::milli>(end - sortStart).count());
+    }
+    std::cout << workers << " workers: fib(32) " << fibMs << "ms, quick-sort "
+              << input.size() << " ints " << sortMs << "ms" << std::endl;
+  }
+}
+
+
+//----------------------------------------------------
+
+int main()
+{
+  auto status = test_entry::run_all();
+  if (status == 0) {
+    std::cout << "**** all OK\n";
+  }
+  return status;
+}
@@ -0,0 +1,404 @@
+// -----------------------------------------------------
+// work-stealing executor for fork/join workloads:
+// -----------------------------------------------------
+#ifndef WORK_STEALING_EXECUTOR_HPP
+#define WORK_STEALING_EXECUTOR_HPP
+
+#include "stop_token.hpp"
+#include "jthread.hpp"
+#include "jthread_pool.hpp"   // for __pool_task
+#include "condition_variable_any2.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace std {
+
+//*****************************************
+//* class __chase_lev_deque
+//* - work-stealing deque (Chase/Lev; memory orders as in Le et al.,
+//*   "Correct and Efficient Work-Stealing for Weak Memory Models")
+//* - the owner pushes and takes at the bottom, thieves steal at the top
+//* - grows on demand; replaced arrays are kept until destruction,
+//*   as a thief may still read from them
+//*****************************************
+template <typename _Tp>
+class __chase_lev_deque {
+ public:
+  explicit __chase_lev_deque(std::size_t __capacity = 256) {
+    __arrays_.push_back(std::make_unique<__array>(__capacity));
+    __array_.store(__arrays_.back().get(), std::memory_order_relaxed);
+  }
+
+  __chase_lev_deque(const __chase_lev_deque&) = delete;
+  __chase_lev_deque& operator=(const __chase_lev_deque&) = delete;
+
+  // owner only:
+  void __push(_Tp* __x) {
+    std::int64_t __b = __bottom_.load(std::memory_order_relaxed);
+    std::int64_t __t = __top_.load(std::memory_order_acquire);
+    __array* __a = __array_.load(std::memory_order_relaxed);
+    if (__b - __t > static_cast<std::int64_t>(__a->__size) - 1) {
+      __a = __grow(__a, __t, __b);
+    }
+    __a->__put(__b, __x);
+    // (a release store rather than fence + relaxed store: same code on
+    // x86/ARM64 and visible to ThreadSanitizer)
+    __bottom_.store(__b + 1, std::memory_order_release);
+  }
+
+  // owner only; nullptr if empty
+  _Tp* __take() noexcept {
+    std::int64_t __b = __bottom_.load(std::memory_order_relaxed) - 1;
+    __array* __a = __array_.load(std::memory_order_relaxed);
+    __bottom_.store(__b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t __t = __top_.load(std::memory_order_relaxed);
+    if (__t > __b) {
+      __bottom_.store(__b + 1, std::memory_order_relaxed);
+      return nullptr;
+    }
+    _Tp* __x = __a->__get(__b);
+    if (__t == __b) {
+      // last element: race against thieves
+      if (!__top_.compare_exchange_strong(__t, __t + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed)) {
+        __x = nullptr;
+      }
+      __bottom_.store(__b + 1, std::memory_order_relaxed);
+    }
+    return __x;
+  }
+
+  // any thread; nullptr if empty or lost a race
+  _Tp* __steal() noexcept {
+    std::int64_t __t = __top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    std::int64_t __b = __bottom_.load(std::memory_order_acquire);
+    if (__t >= __b) {
+      return nullptr;
+    }
+    __array* __a = __array_.load(std::memory_order_acquire);
+    _Tp* __x = __a->__get(__t);
+    if (!__top_.compare_exchange_strong(__t, __t + 1,
+                                        std::memory_order_seq_cst,
+                                        std::memory_order_relaxed)) {
+      return nullptr;
+    }
+    return __x;
+  }
+
+  bool __empty() const noexcept {
+    return __bottom_.load(std::memory_order_acquire) <=
+           __top_.load(std::memory_order_acquire);
+  }
+
+ private:
+  struct __array {
+    explicit __array(std::size_t __size)
+     : __size{__size}, __slots{new std::atomic<_Tp*>[__size]} {
+    }
+    _Tp* __get(std::int64_t __i) const noexcept {
+      return __slots[static_cast<std::size_t>(__i) & (__size - 1)]
+               .load(std::memory_order_relaxed);
+    }
+    void __put(std::int64_t __i, _Tp* __x) noexcept {
+      __slots[static_cast<std::size_t>(__i) & (__size - 1)]
+        .store(__x, std::memory_order_relaxed);
+    }
+    std::size_t __size;   // power of 2
+    std::unique_ptr<std::atomic<_Tp*>[]> __slots;
+  };
+
+  __array* __grow(__array* __old, std::int64_t __t, std::int64_t __b) {
+    __arrays_.push_back(std::make_unique<__array>(__old->__size * 2));
+    __array* __a = __arrays_.back().get();
+    for (std::int64_t __i = __t; __i < __b; ++__i) {
+      __a->__put(__i, __old->__get(__i));
+    }
+    __array_.store(__a, std::memory_order_release);
+    return __a;
+  }
+
+  alignas(64) std::atomic<std::int64_t> __top_{0};
+  alignas(64) std::atomic<std::int64_t> __bottom_{0};
+  std::atomic<__array*> __array_{nullptr};
+  std::vector<std::unique_ptr<__array>> __arrays_{};   // owner only
+};
+
+
+//*****************************************
+//* class work_stealing_executor
+//* - one __chase_lev_deque per worker; workers are jthreads that all use
+//*   the executor's stop token
+//* - submit() from a worker pushes to its own deque (LIFO for itself,
+//*   FIFO for thieves); from other threads to a shared injection queue
+//* - workers without work steal from random victims, then sleep in
+//*   condition_variable_any2::wait() on the executor's token
+//* - a task whose stop_token is stopped when it is taken or stolen is
+//*   dropped without running
+//* - run_until(done) runs tasks on the calling thread until done()
+//*   (e.g. to wait for forked tasks without blocking a worker)
+//*   - returns false once stop is requested on the executor: forked
+//*     tasks may have been dropped, so done() might never become true
+//*   - (forked tasks already running may still finish after that:
+//*     state they use must not live in the waiting frame alone)
+//* - destructor: request stop, join the workers, drop the queued tasks
+//*****************************************
+class work_stealing_executor {
+ public:
+  explicit work_stealing_executor(
+      std::size_t __workers = jthread::hardware_concurrency()) {
+    if (__workers == 0) {
+      __workers = 1;
+    }
+    for (std::size_t __i = 0; __i < __workers; ++__i) {
+      __queues_.push_back(std::make_unique<__worker_queue>());
+    }
+    __workers_.reserve(__workers);
+    for (std::size_t __i = 0; __i < __workers; ++__i) {
+      __workers_.emplace_back([this, __i] { __work(__i); });
+    }
+  }
+
+  work_stealing_executor(const work_stealing_executor&) = delete;
+  work_stealing_executor& operator=(const work_stealing_executor&) = delete;
+
+  ~work_stealing_executor() {
+    __source_.request_stop();   // wakes sleeping workers
+    __workers_.clear();
+    for (auto& __q : __queues_) {
+      while (__task_t* __task = __q->__deque.__take()) {
+        delete __task;
+      }
+    }
+    __injected_.clear();
+  }
+
+  template <typename _Callable>
+  void submit(_Callable&& __cb) {
+    __submit(__pool_task{std::forward<_Callable>(__cb), __source_.get_token()});
+  }
+
+  template <typename _Callable>
+  void submit(_Callable&& __cb, stop_token __st) {
+    if (__st.stop_requested()) {
+      return;
+    }
+    __submit(__pool_task{std::forward<_Callable>(__cb), std::move(__st)});
+  }
+
+  template <typename _Predicate>
+  bool run_until(_Predicate __done) {
+    const std::size_t __self = __current_worker();
+    unsigned __misses = 0;
+    while (!__done()) {
+      if (__source_.stop_requested()) {
+        return false;   // forked tasks may have been dropped
+      }
+      if (__task_t* __task = __find_task(__self)) {
+        __execute(__task);
+        __misses = 0;
+      }
+      else if (++__misses > 64) {
+        std::this_thread::yield();
+      }
+    }
+    return true;
+  }
+
+  [[nodiscard]] std::size_t size() const noexcept {
+    return __workers_.size();
+  }
+
+  [[nodiscard]] stop_source get_stop_source() const noexcept {
+    return __source_;
+  }
+  [[nodiscard]] stop_token get_stop_token() const noexcept {
+    return __source_.get_token();
+  }
+  bool request_stop() noexcept {
+    return __source_.request_stop();
+  }
+
+ private:
+  using __task_t = __pool_task;
+  static constexpr std::size_t __none = static_cast<std::size_t>(-1);
+
+  struct __worker_queue {
+    __chase_lev_deque<__task_t> __deque{};
+    std::uint64_t __rng = 0;   // owner only: victim selection
+  };
+
+  struct __current_t {
+    const work_stealing_executor* __executor = nullptr;
+    std::size_t __index = __none;
+  };
+  static __current_t& __current() noexcept {
+    static thread_local __current_t __c{};
+    return __c;
+  }
+
+  // index of the calling worker of this executor (__none otherwise)
+  std::size_t __current_worker() const noexcept {
+    const __current_t& __c = __current();
+    return __c.__executor == this ? __c.__index : __none;
+  }
+
+  void __submit(__pool_task&& __task) {
+    auto __node = std::make_unique<__task_t>(std::move(__task));
+    const std::size_t __self = __current_worker();
+    if (__self != __none) {
+      __queues_[__self]->__deque.__push(__node.release());
+    }
+    else {
+      std::lock_guard<std::mutex> __lock{__injectMutex_};
+      __injected_.push_back(std::move(__node));
+      __injectedCount_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // pairs with the fence in __sleep(): either a sleeper sees the task
+    // or we see the sleeper
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (__sleepers_.load(std::memory_order_relaxed) > 0) {
+      {
+        std::lock_guard<std::mutex> __lock{__sleepMutex_};
+        ++__epoch_;
+      }
+      __wake_.notify_one();
+    }
+  }
+
+  void __execute(__task_t* __task) noexcept {
+    std::unique_ptr<__task_t> __owned{__task};
+    if (!__owned->__token().stop_requested()) {
+      __owned->__run();
+    }
+  }
+
+  __task_t* __take_injected() noexcept {
+    if (__injectedCount_.load(std::memory_order_relaxed) == 0) {
+      return nullptr;
+    }
+    std::lock_guard<std::mutex> __lock{__injectMutex_};
+    if (__injected_.empty()) {
+      return nullptr;
+    }
+    __task_t* __task = __injected_.front().release();
+    __injected_.pop_front();
+    __injectedCount_.fetch_sub(1, std::memory_order_relaxed);
+    return __task;
+  }
+
+  __task_t* __steal(std::size_t __self) noexcept {
+    const std::size_t __n = __queues_.size();
+    std::size_t __start;
+    if (__self != __none) {
+      // xorshift64 per worker
+      std::uint64_t& __x = __queues_[__self]->__rng;
+      if (__x == 0) {
+        __x = 0x9E3779B97F4A7C15ull * (__self + 1);
+      }
+      __x ^= __x << 13;
+      __x ^= __x >> 7;
+      __x ^= __x << 17;
+      __start = static_cast<std::size_t>(__x % __n);
+    }
+    else {
+      __start = 0;
+    }
+    for (std::size_t __i = 0; __i < __n; ++__i) {
+      std::size_t __victim = (__start + __i) % __n;
+      if (__victim == __self) {
+        continue;
+      }
+      if (__task_t* __task = __queues_[__victim]->__deque.__steal()) {
+        return __task;
+      }
+    }
+    return nullptr;
+  }
+
+  __task_t* __find_task(std::size_t __self) noexcept {
+    if (__self != __none) {
+      if (__task_t* __task = __queues_[__self]->__deque.__take()) {
+        return __task;
+      }
+    }
+    if (__task_t* __task = __take_injected()) {
+      return __task;
+    }
+    return __steal(__self);
+  }
+
+  bool __any_work() const noexcept {
+    if (__injectedCount_.load(std::memory_order_relaxed) > 0) {
+      return true;
+    }
+    for (auto& __q : __queues_) {
+      if (!__q->__deque.__empty()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void __sleep(const stop_token& __st) {
+    std::unique_lock<std::mutex> __lock{__sleepMutex_};
+    const std::uint64_t __seen = __epoch_;
+    __sleepers_.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (!__any_work()) {
+      __wake_.wait(__lock, __st, [&] { return __epoch_ != __seen; });
+    }
+    __sleepers_.fetch_sub(1, std::memory_order_relaxed);
+  }
+
+  void __work(std::size_t __self) noexcept {
+    // reset on exit: the OS thread may run other code afterwards
+    // (e.g. reused by the jthread cache, see set_jthread_cache_limit())
+    struct __current_guard {
+      __current_guard(const work_stealing_executor* __e, std::size_t __i) noexcept {
+        __current() = {__e, __i};
+      }
+      ~__current_guard() {
+        __current() = {};
+      }
+    } __guard{this, __self};
+    const stop_token __st = __source_.get_token();
+    unsigned __misses = 0;
+    while (!__st.stop_requested()) {
+      if (__task_t* __task = __find_task(__self)) {
+        __execute(__task);
+        __misses = 0;
+      }
+      else if (++__misses < 64) {
+        std::this_thread::yield();
+      }
+      else {
+        __sleep(__st);
+        __misses = 0;
+      }
+    }
+  }
+
+  stop_source __source_{};
+  std::vector<std::unique_ptr<__worker_queue>> __queues_{};
+  std::mutex __injectMutex_{};
+  std::deque<std::unique_ptr<__task_t>> __injected_{};
+  std::atomic<std::size_t> __injectedCount_{0};
+  std::mutex __sleepMutex_{};
+  condition_variable_any2 __wake_{};
+  std::uint64_t __epoch_ = 0;              // guarded by __sleepMutex_
+  std::atomic<unsigned> __sleepers_{0};
+  std::vector<jthread> __workers_{};       // last: end before the queues
+};
+
+} // std
+
+#endif // WORK_STEALING_EXECUTOR_HPP